@@ -21,6 +21,11 @@ https://github.com/benhoyt/inih
 #include <stdlib.h>
 #endif
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #define MAX_SECTION 50
 #define MAX_NAME 50
 
@@ -49,7 +54,8 @@ static char* find_chars_or_comment(const char* s, const char* chars)
 #if INI_ALLOW_INLINE_COMMENTS
     int was_space = 0;
     while (*s && (!chars || !strchr(chars, *s)) &&
-           !(was_space && strchr(INI_INLINE_COMMENT_PREFIXES, *s))) {
+           !(was_space && strchr(INI_INLINE_COMMENT_PREFIXES, *s) &&
+             (!INI_INLINE_ANNOTATION_CHAR || s[1] != INI_INLINE_ANNOTATION_CHAR))) {
         was_space = isspace((unsigned char)(*s));
         s++;
     }
@@ -192,3 +198,161 @@ int ini_parse(const char* filename, ini_handler handler, void* user)
     fclose(file);
     return error;
 }
+
+/* Span versions of rstrip, lskip and find_chars_or_comment for
+   ini_parse_mapped(): "e" is one past the last char. */
+static const char* rstrip_span(const char* s, const char* e)
+{
+    while (e > s && isspace((unsigned char)(e[-1])))
+        e--;
+    return e;
+}
+
+static const char* lskip_span(const char* s, const char* e)
+{
+    while (s < e && isspace((unsigned char)(*s)))
+        s++;
+    return s;
+}
+
+static const char* find_chars_or_comment_span(const char* s, const char* e,
+                                              const char* chars)
+{
+#if INI_ALLOW_INLINE_COMMENTS
+    int was_space = 0;
+    while (s < e && (!chars || !strchr(chars, *s)) &&
+           !(was_space && strchr(INI_INLINE_COMMENT_PREFIXES, *s) &&
+             (!INI_INLINE_ANNOTATION_CHAR || s + 1 >= e ||
+              s[1] != INI_INLINE_ANNOTATION_CHAR))) {
+        was_space = isspace((unsigned char)(*s));
+        s++;
+    }
+#else
+    while (s < e && (!chars || !strchr(chars, *s))) {
+        s++;
+    }
+#endif
+    return s;
+}
+
+static ini_span make_span(const char* s, const char* e)
+{
+    ini_span span;
+    span.p = s;
+    span.len = (size_t)(e - s);
+    return span;
+}
+
+/* See documentation in header file. */
+int ini_parse_mapped(const char* filename, ini_span_handler handler,
+                     void* user)
+{
+    int fd;
+    struct stat st;
+    const char* data;
+    const char* line;
+    const char* next;
+    const char* file_end;
+    const char* start;
+    const char* end;
+    const char* name_end;
+    const char* value;
+    ini_span section = { "", 0 };
+    ini_span prev_name = { "", 0 };
+    int lineno = 0;
+    int error = 0;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    data = (const char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                             fd, 0);
+    close(fd);
+    if (data == (const char*)MAP_FAILED)
+        return -2;
+    file_end = data + st.st_size;
+
+    /* Scan through the mapping line by line */
+    for (line = data; line < file_end; line = next) {
+        end = (const char*)memchr(line, '\n', (size_t)(file_end - line));
+        next = end ? end + 1 : file_end;
+        end = end ? end : file_end;
+        lineno++;
+
+        start = line;
+#if INI_ALLOW_BOM
+        if (lineno == 1 && end - start >= 3 &&
+                           (unsigned char)start[0] == 0xEF &&
+                           (unsigned char)start[1] == 0xBB &&
+                           (unsigned char)start[2] == 0xBF) {
+            start += 3;
+        }
+#endif
+        end = rstrip_span(start, end);
+        start = lskip_span(start, end);
+
+        if (start < end && (*start == ';' || *start == '#')) {
+            /* Per Python configparser, allow both ; and # comments at the
+               start of a line */
+        }
+#if INI_ALLOW_MULTILINE
+        else if (prev_name.len && start < end && start > line) {
+            /* Non-blank line with leading whitespace, treat as continuation
+               of previous name's value (as per Python configparser). */
+            if (!handler(user, section, prev_name, make_span(start, end)) &&
+                !error)
+                error = lineno;
+        }
+#endif
+        else if (start < end && *start == '[') {
+            /* A "[section]" line */
+            name_end = find_chars_or_comment_span(start + 1, end, "]");
+            if (name_end < end && *name_end == ']') {
+                section = make_span(start + 1, name_end);
+                prev_name = make_span("", "");
+            }
+            else if (!error) {
+                /* No ']' found on section line */
+                error = lineno;
+            }
+        }
+        else if (start < end) {
+            /* Not a comment, must be a name[=:]value pair */
+            name_end = find_chars_or_comment_span(start, end, "=:");
+            if (name_end < end && (*name_end == '=' || *name_end == ':')) {
+                value = lskip_span(name_end + 1, end);
+#if INI_ALLOW_INLINE_COMMENTS
+                end = find_chars_or_comment_span(value, end, NULL);
+#endif
+                end = rstrip_span(value, end);
+                name_end = rstrip_span(start, name_end);
+
+                /* Valid name[=:]value pair found, call handler */
+                prev_name = make_span(start, name_end);
+                if (!handler(user, section, prev_name, make_span(value, end)) &&
+                    !error)
+                    error = lineno;
+            }
+            else if (!error) {
+                /* No '=' or ':' found on name[=:]value line */
+                error = lineno;
+            }
+        }
+
+#if INI_STOP_ON_FIRST_ERROR
+        if (error)
+            break;
+#endif
+    }
+
+    munmap((void*)data, (size_t)st.st_size);
+    return error;
+}
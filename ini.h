@@ -48,6 +48,23 @@ int ini_parse_file(FILE* file, ini_handler handler, void* user);
 int ini_parse_stream(ini_reader reader, void* stream, ini_handler handler,
                      void* user);
 
+/* A string that is not NUL-terminated: "len" chars at "p". */
+typedef struct {
+    const char* p;
+    size_t len;
+} ini_span;
+
+/* Typedef for prototype of span handler function. */
+typedef int (*ini_span_handler)(void* user, ini_span section, ini_span name,
+                                ini_span value);
+
+/* Same as ini_parse(), but memory-maps the file and passes section, name
+   and value as spans into the mapping (valid only for the duration of the
+   handler call) instead of copying each line. There is no line length
+   limit. Returns as ini_parse(); -2 if the file can not be mapped. */
+int ini_parse_mapped(const char* filename, ini_span_handler handler,
+                     void* user);
+
 /* Nonzero to allow multi-line value parsing, in the style of Python's
    configparser. If allowed, ini_parse() will call the handler with the same
    name for each subsequent line parsed. */
@@ -71,6 +88,12 @@ int ini_parse_stream(ini_reader reader, void* stream, ini_handler handler,
 #define INI_INLINE_COMMENT_PREFIXES ";"
 #endif
 
+/* Character that, right after an inline comment prefix, marks an annotation
+   kept as part of the value (e.g. "field=X ;@hot=10"). 0 to disable. */
+#ifndef INI_INLINE_ANNOTATION_CHAR
+#define INI_INLINE_ANNOTATION_CHAR '@'
+#endif
+
 /* Nonzero to use stack, zero to use heap (malloc/free). */
 #ifndef INI_USE_STACK
 #define INI_USE_STACK 1
@@ -1,9 +1,14 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <map>
 #include <cstring>
 #include <cstdio>
 #include <cstdarg>
+#include <cerrno>
+#include <cstdint>
 
 // string trimming
 #include <algorithm> 
@@ -14,10 +19,19 @@
 // filesystem
 #include <filesystem>
 
+// worker pool (-j)
+#include <thread>
+#include <mutex>
+#include <atomic>
+
 //
 // POSIX
 //
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <fnmatch.h>
 //
@@ -32,26 +46,51 @@
 
 extern "C"
 {
-	#define INI_MAX_LINE 2048
 	#include "ini.h"
 }
 
 bool g_silentMode = true;
 
+// per worker: log lines collect here and are printed per input file
+thread_local std::string *g_threadLog = nullptr;
+thread_local bool g_threadSilent = false;
+std::mutex g_logMutex;
+
 
 void logf(const char *fmt, ...)
 {
-	if (!g_silentMode)
+	if (!g_silentMode && !g_threadSilent)
 	{
 		va_list args;
 		
 		va_start(args, fmt);
-		vprintf(fmt, args);
+		if (g_threadLog)
+		{
+			char buf[1024];
+			int n = vsnprintf(buf, sizeof(buf), fmt, args);
+			if (n >= (int)sizeof(buf))
+			{
+				std::string big(n, '\0');
+				va_end(args);
+				va_start(args, fmt);
+				vsnprintf(&big[0], n + 1, fmt, args);
+				*g_threadLog += big;
+			}
+			else if (n > 0)
+			{
+				*g_threadLog += buf;
+			}
+		}
+		else
+		{
+			vprintf(fmt, args);
+		}
 		va_end(args);
 	}
 }
 
 
+
 // trim from start
 static inline std::string ltrim(const std::string &spar) 
 {
@@ -77,10 +116,14 @@ static inline std::string trim(const std::string &spar)
     return ltrim(rtrim(s));
 }
 
-void enumExtractName(const std::string &input, std::string &output);
-std::string enumGetThraitsData(const std::string &input, std::string &output);
+class stringarena;
+void enumExtractName(std::string_view input, std::string_view &output);
+std::string_view enumGetThraitsData(std::string_view input, std::string_view &output);
+std::string_view enumGetAnnotations(std::string_view input, unsigned long long &weight, stringarena &strings);
+std::string_view trimView(std::string_view text);
 
 int iniFieldHandler(void* data, const char* section, const char* name, const char* value);
+int iniSpanHandler(void *data, ini_span section, ini_span name, ini_span value);
 
 /////////////////
 struct options 
@@ -89,6 +132,12 @@ struct options
 	bool help;
 	bool version_out;
 	bool verbose;
+	bool emitBench;
+	bool tune;
+	unsigned jobs;
+	std::string manifest;
+	bool depfile;
+	std::string depfileName;
 	std::string wdir;
 	
 	options()
@@ -97,6 +146,10 @@ struct options
 		help = false;
 		version_out = false;
 		verbose = false;
+		emitBench = false;
+		tune = false;
+		depfile = false;
+		jobs = std::max(1U, std::thread::hardware_concurrency());
 		wdir = ".";
 	}
 };
@@ -106,28 +159,113 @@ enum strposflags
 	STRPOSFLAGS_FIRST, STRPOSFLAGS_LAST
 };
 
+//
+// How XxxToIndex maps a value to its index
+//
+enum lookupstrategy
+{
+	LOOKUP_AUTO, LOOKUP_LINEAR, LOOKUP_OFFSET, LOOKUP_TABLE, LOOKUP_BINARY, LOOKUP_SWITCH
+};
+
+const char *g_lookupStrategyNames[] = { "auto", "linear", "offset", "table", "binary", "switch" };
+
+//
+// Formatting library integrations emitted for a section (format=...)
+//
+enum formatterflags
+{
+	FORMATTER_OSTREAM = 1, FORMATTER_STD = 2, FORMATTER_FMT = 4
+};
+
+//
+// How XxxFromString finds a name
+//
+enum stringlookup
+{
+	STRLOOKUP_AUTO, STRLOOKUP_HASH, STRLOOKUP_LINEAR
+};
+
+enum wireencoding
+{
+	ENCODE_NONE, ENCODE_FIXED, ENCODE_VARINT
+};
+
+//
+// Generated functions counted under stats-define
+//
+enum statfunction
+{
+	STAT_TOSTRING, STAT_FROMSTRING, STAT_TOINDEX, STAT_GETTHRAITS, STAT_COUNT
+};
+
+const char *g_statFunctionNames[] = { "ToString", "FromString", "ToIndex", "GetThraits" };
+
+//
+// Bump allocator for field strings, one allocation per block instead of
+// several per field. Stored strings are NUL-terminated, so data() of a
+// returned view can be used as a C string.
+//
+class stringarena
+{
+public:
+	std::string_view store(std::string_view text)
+	{
+		size_t size = text.size() + 1;
+		if (m_used + size > m_blockSize)
+		{
+			m_blockSize = std::max(size, (size_t)65536);
+			m_blocks.emplace_back(new char[m_blockSize]);
+			m_used = 0;
+		}
+		
+		char *p = m_blocks.back().get() + m_used;
+		if (text.size() > 0) memcpy(p, text.data(), text.size());
+		p[text.size()] = 0;
+		m_used += size;
+		
+		return std::string_view(p, text.size());
+	}
+
+private:
+	std::vector<std::unique_ptr<char[]>> m_blocks;
+	size_t m_used = 0;
+	size_t m_blockSize = 0;
+};
+
 class Entry
 {
 public:
-	Entry(std::string fullText) 
+	// the strings of the entry live in "strings"
+	Entry(std::string_view fullText, stringarena &strings) 
 	{
-		fullText = enumGetThraitsData(fullText, m_thraits);
-		enumExtractName(fullText, m_name);
+		std::string_view name, thraits;
+		fullText = enumGetAnnotations(fullText, m_weight, strings);
+		fullText = enumGetThraitsData(fullText, thraits);
+		enumExtractName(fullText, name);
 		
-		m_fullText = trim(fullText);
+		fullText = trimView(fullText);
+		m_fullText = strings.store(fullText);
+		m_name = strings.store(trimView(name));
+		m_thraits = strings.store(trimView(thraits));
 		
-		m_name = trim(m_name);
-		m_thraits = trim(m_thraits);
+		size_t posE = fullText.find('=');
+		m_valueExpr = strings.store(posE != std::string_view::npos ? trimView(fullText.substr(posE + 1)) : std::string_view());
 	}
 
-	const std::string &name() const { return m_name; }
-	const std::string &fullText() const { return m_fullText; }
-	const std::string &thraits() const { return m_thraits; }
+	std::string_view name() const { return m_name; }
+	std::string_view fullText() const { return m_fullText; }
+	std::string_view thraits() const { return m_thraits; }
+	std::string_view valueExpr() const { return m_valueExpr; }
+	
+	unsigned long long weight() const { return m_weight; }
+	void weight(unsigned long long val) { m_weight = val; }
 
 private:
-	std::string m_name;
-	std::string m_fullText;
-	std::string m_thraits;
+	std::string_view m_name;
+	std::string_view m_fullText;
+	std::string_view m_thraits;
+	std::string_view m_valueExpr;
+	unsigned long long m_weight = 0;
 };
 
 class Section
@@ -149,6 +287,32 @@ public:
 	const std::string &thraitsEnableMacro() const { return m_thraitsEnableMacro; }
 	void thraitsEnableMacro(const std::string &val) { m_thraitsEnableMacro = val; }
 	
+	int lookup() const { return m_lookup; }
+	void lookup(int val) { m_lookup = val; }
+	
+	int stringLookup() const { return m_stringLookup; }
+	void stringLookup(int val) { m_stringLookup = val; }
+	
+	int formatters() const { return m_formatters; }
+	void formatters(int val) { m_formatters = val; }
+	
+	bool containers() const { return m_containers; }
+	void containers(bool val) { m_containers = val; }
+	
+	bool flags() const { return m_flags; }
+	void flags(bool val) { m_flags = val; }
+	
+	bool dispatch() const { return m_dispatch; }
+	void dispatch(bool val) { m_dispatch = val; }
+	
+	int encoding() const { return m_encoding; }
+	void encoding(int val) { m_encoding = val; }
+	
+	// explicit common prefix (prefix=); empty string for none
+	bool prefixSet() const { return m_prefixSet; }
+	const std::string &prefix() const { return m_prefix; }
+	void prefix(const std::string &val) { m_prefix = val; m_prefixSet = true; }
+	
 	const std::vector<Entry> &entries() const { return m_entries; }
 	std::vector<Entry> &entries() { return m_entries; }
 	
@@ -157,9 +321,45 @@ private:
 	std::string m_type;
 	std::string m_thraitsName;
 	std::string m_thraitsEnableMacro;
+	int m_lookup = LOOKUP_AUTO;
+	int m_stringLookup = STRLOOKUP_AUTO;
+	int m_formatters = 0;
+	bool m_containers = false;
+	bool m_flags = false;
+	bool m_dispatch = false;
+	int m_encoding = ENCODE_NONE;
+	bool m_prefixSet = false;
+	std::string m_prefix;
 	std::vector<Entry> m_entries;
 };
 
+//
+// Values of a section as far as they can be evaluated at generation time
+//
+struct indexplan
+{
+	int strategy;
+	bool resolved;
+	long long minValue;
+	long long maxValue;
+	std::vector<long long> values;     // value of each entry, declaration order
+	std::vector<unsigned> firstIndex;  // entries whose value is not a duplicate
+	std::vector<unsigned> searchOrder; // firstIndex by descending weight
+	std::vector<unsigned> hot;         // checked ahead of switch/binary lookups
+	bool weighted;
+	bool compact;                      // value range small enough for a table
+	
+	indexplan()
+	{
+		strategy = LOOKUP_LINEAR;
+		resolved = false;
+		weighted = false;
+		compact = false;
+		minValue = 0;
+		maxValue = 0;
+	}
+};
+
 struct statefields
 {
 	std::string fileName;
@@ -174,9 +374,39 @@ struct statefields
 	std::string includeDir;
 	bool firstField;
 	bool cppStringifyDisable;
+	bool headerOnly = false;
+	bool sizeProfile = false;
+	std::string tableSection;
+	std::string weightsFile;
+	std::string statsDefine;
+	bool emitBench = false;
+	std::string tuneCache = ".enumg_tune";
+	
+	// field strings of all sections
+	stringarena strings;
+	
+	// files read (the ini, weights) and written, for --manifest
+	std::vector<std::string> inputFiles;
+	std::vector<std::string> outputFiles;
 	
 	std::vector<Section> sections;
 	
+	//
+	// storage/linkage prefixes for generated definitions; in header-only
+	// mode everything is inline (and constexpr where possible) in the header
+	//
+	const char *constexprFn() const { return headerOnly ? "inline constexpr " : ""; }
+	const char *externFn() const { return headerOnly ? "inline " : ""; }
+	const char *localFn() const { return headerOnly ? "inline " : "static inline "; }
+	const char *localConstexprFn() const { return headerOnly ? "inline constexpr " : "static inline "; }
+	const char *globalStorage() const { return headerOnly ? "inline constexpr " : ""; }
+	const char *localStorage() const { return headerOnly ? "inline constexpr " : "static "; }
+	std::string localTable() const
+	{
+		std::string attr = tableSection.empty() ? "" : "__attribute__((section(\"" + tableSection + "\"))) ";
+		return attr + (headerOnly ? "inline constexpr " : "static const ");
+	}
+	
 	Section &currentSection() { return sections[sections.size()-1]; }
 
 	std::vector<std::string> topExprs;
@@ -194,6 +424,17 @@ void printHelp(const char *cmdName)
 	logf("options:\n");
 	logf("  -v        : print version and exit\n");
 	logf("  -V        : verbose output\n");
+	logf("  --emit-bench : also write <title>_bench.<c-source>, a benchmark\n");
+	logf("               of the generated functions\n");
+	logf("  --tune    : pick ToIndex/FromString strategies of lookup=auto\n");
+	logf("               sections by timing them with $CXX (default c++)\n");
+	logf("  --manifest=FILE : skip inputs whose ini, dependencies, outputs\n");
+	logf("               and options are unchanged since the last run\n");
+	logf("  -MD       : write make dependencies of each input to\n");
+	logf("               <src-dir><title>.d\n");
+	logf("  -MF FILE  : write the dependencies of all inputs to FILE\n");
+	logf("  -j N      : process up to N input files in parallel\n");
+	logf("               (default: number of CPUs)\n");
 	logf("  -h        : this screen\n");
 	logf("            : this screen (no arguments)\n");
 }
@@ -242,9 +483,70 @@ int strlpos(const char *str, int ch)
 	return strxpos(str, ch, STRPOSFLAGS_LAST);
 }
 
+//
+// Read field weights from a profile: "Enum FIELD weight" per line,
+// '#' starts a comment. Same format as XxxDumpStats writes.
+//
+void loadWeights(struct statefields &S)
+{
+	FILE *fp = fopen(S.weightsFile.c_str(), "r");
+	if (!fp)
+	{
+		fprintf(stderr, "can not open weights file \"%s\"\n", S.weightsFile.c_str());
+		exit(1);
+	}
+	
+	char line[1024];
+	unsigned lineNo = 0;
+	while (fgets(line, sizeof(line), fp))
+	{
+		++lineNo;
+		char *comment = strchr(line, '#');
+		if (comment) *comment = 0;
+		
+		char enumName[256], fieldName[256];
+		unsigned long long weight;
+		int n = sscanf(line, "%255s %255s %llu", enumName, fieldName, &weight);
+		if (n <= 0) continue;
+		if (n != 3)
+		{
+			fprintf(stderr, "%s:%u: expected \"Enum FIELD weight\"\n", S.weightsFile.c_str(), lineNo);
+			exit(1);
+		}
+		
+		bool found = false;
+		for (auto &section : S.sections)
+		{
+			if (section.name() != enumName) continue;
+			for (auto &entry : section.entries())
+			{
+				if (entry.name() == fieldName)
+				{
+					entry.weight(weight);
+					found = true;
+				}
+			}
+		}
+		
+		if (!found)
+		{
+			fprintf(stderr, "warning: %s:%u: no field %s in [%s]\n", S.weightsFile.c_str(), lineNo, fieldName, enumName);
+		}
+	}
+	
+	fclose(fp);
+}
+
 void process(struct statefields &S, struct options &opts, const char *file)
 {
-	ini_parse(file, iniFieldHandler, &S);
+	ini_parse_mapped(file, iniSpanHandler, &S);
+	S.inputFiles.push_back(file);
+	
+	if (S.weightsFile.size() > 0)
+	{
+		loadWeights(S);
+		S.inputFiles.push_back(S.weightsFile);
+	}
 }
 
 bool getSubParam(const char *param, std::string &valOut, int paramIndex)
@@ -278,7 +580,23 @@ bool getSubParam(const char *param, std::string &valOut, int paramIndex)
 
 bool checkParam(std::vector<std::string> &allFiles, struct options &opts, const char *param)
 {
-	if (isParam(param, "-h"))
+	if (isParam(param, "--emit-bench"))
+	{
+		opts.emitBench = true;
+	}
+	else if (isParam(param, "--tune"))
+	{
+		opts.tune = true;
+	}
+	else if (isParam(param, "-MD"))
+	{
+		opts.depfile = true;
+	}
+	else if (isParam(param, "--manifest="))
+	{
+		opts.manifest = param + strlen("--manifest=");
+	}
+	else if (isParam(param, "-h"))
 	{
 		opts.verbose = true;
 		opts.help = true;
@@ -325,14 +643,14 @@ void signalHandler(int sig)
 	exit(1);
 }
 
-void enumExtractName(const std::string &input, std::string &output)
+void enumExtractName(std::string_view input, std::string_view &output)
 {
-	int posE = strfpos(input.c_str(), '=');
-	int posP = strfpos(input.c_str(), '(');
+	size_t posE = input.find('=');
+	size_t posP = input.find('(');
 	
-	int pos = posE > 0 ? posE : posP;
+	size_t pos = posE != std::string_view::npos && posE > 0 ? posE : posP;
 	
-	if (pos > 0)
+	if (pos != std::string_view::npos && pos > 0)
 	{
 		output = input.substr(0, pos);
 	}
@@ -342,11 +660,50 @@ void enumExtractName(const std::string &input, std::string &output)
 	}
 }
 
-std::string enumGetThraitsData(const std::string &input, std::string &output)
+std::string_view trimView(std::string_view text)
+{
+	while (text.size() > 0 && isspace((unsigned char)text.front())) text.remove_prefix(1);
+	while (text.size() > 0 && isspace((unsigned char)text.back())) text.remove_suffix(1);
+	return text;
+}
+
+//
+// Strip ";@name=value" annotations from a field definition; "@hot=N" sets
+// the lookup weight of the field
+//
+std::string_view enumGetAnnotations(std::string_view input, unsigned long long &weight, stringarena &strings)
+{
+	if (input.find(";@") == std::string_view::npos) return input;
+	
+	std::string text(input);
+	size_t pos;
+	
+	while ((pos = text.find(";@")) != std::string::npos)
+	{
+		size_t end = text.find_first_of(" \t;", pos + 2);
+		std::string annotation = text.substr(pos + 2, end == std::string::npos ? std::string::npos : end - pos - 2);
+		
+		if (annotation.compare(0, 4, "hot=") == 0)
+		{
+			weight = strtoull(annotation.c_str() + 4, nullptr, 0);
+		}
+		else
+		{
+			fprintf(stderr, "unknown field annotation \"@%s\"\n", annotation.c_str());
+			exit(1);
+		}
+		
+		text.erase(pos, end == std::string::npos ? std::string::npos : end - pos);
+	}
+	
+	return strings.store(text);
+}
+
+std::string_view enumGetThraitsData(std::string_view input, std::string_view &output)
 {
-	int posP = strfpos(input.c_str(), '(');
+	size_t posP = input.find('(');
 	
-	if (posP >= 0)
+	if (posP != std::string_view::npos)
 	{
 		output = input.substr(posP);
 		return input.substr(0, posP);
@@ -370,6 +727,19 @@ void extractFileTitle(const std::string &input, std::string &output)
 	}
 }
 
+int parseLookupStrategy(const char *value)
+{
+	for (unsigned i = 0; i < sizeof(g_lookupStrategyNames) / sizeof(g_lookupStrategyNames[0]); ++i)
+	{
+		if (strcmp(value, g_lookupStrategyNames[i]) == 0)
+		{
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
 int iniFieldHandler(void* data, const char* section, const char* name, const char* value)
 {
 	logf("[%s]%s=%s\n", section, name, value);
@@ -420,10 +790,83 @@ int iniFieldHandler(void* data, const char* section, const char* name, const cha
 	{
 		S.currentSection().thraitsEnableMacro(value);
 	}
+	else if (strcmp(name, "lookup") == 0)
+	{
+		int strategy = parseLookupStrategy(value);
+		if (strategy < 0)
+		{
+			fprintf(stderr, "unknown lookup strategy \"%s\" in [%s]\n", value, section);
+			exit(1);
+		}
+		
+		S.currentSection().lookup(strategy);
+	}
+	else if (strcmp(name, "format") == 0)
+	{
+		int flags = 0;
+		std::string list = value;
+		std::replace(list.begin(), list.end(), ',', ' ');
+		char buf[list.size() + 1];
+		strcpy(buf, list.c_str());
+		char *save = nullptr;
+		for (const char *tok = strtok_r(buf, " \t", &save); tok != nullptr; tok = strtok_r(nullptr, " \t", &save))
+		{
+			if (strcmp(tok, "ostream") == 0) flags |= FORMATTER_OSTREAM;
+			else if (strcmp(tok, "std") == 0) flags |= FORMATTER_STD;
+			else if (strcmp(tok, "fmt") == 0) flags |= FORMATTER_FMT;
+			else
+			{
+				fprintf(stderr, "unknown format \"%s\" in [%s]\n", tok, section);
+				exit(1);
+			}
+		}
+		
+		S.currentSection().formatters(flags);
+	}
+	else if (strcmp(name, "flags") == 0)
+	{
+		S.currentSection().flags(strcmp(value, "yes") == 0);
+	}
+	else if (strcmp(name, "dispatch") == 0)
+	{
+		S.currentSection().dispatch(strcmp(value, "yes") == 0);
+	}
+	else if (strcmp(name, "containers") == 0)
+	{
+		S.currentSection().containers(strcmp(value, "yes") == 0);
+	}
+	else if (strcmp(name, "string-lookup") == 0)
+	{
+		if (strcmp(value, "hash") == 0) S.currentSection().stringLookup(STRLOOKUP_HASH);
+		else if (strcmp(value, "linear") == 0) S.currentSection().stringLookup(STRLOOKUP_LINEAR);
+		else
+		{
+			fprintf(stderr, "unknown string-lookup \"%s\" in [%s]\n", value, section);
+			exit(1);
+		}
+	}
+	else if (strcmp(name, "prefix") == 0)
+	{
+		S.currentSection().prefix(strcmp(value, "none") == 0 ? "" : value);
+	}
+	else if (strcmp(name, "encode") == 0)
+	{
+		if (strcmp(value, "fixed") == 0) S.currentSection().encoding(ENCODE_FIXED);
+		else if (strcmp(value, "varint") == 0) S.currentSection().encoding(ENCODE_VARINT);
+		else
+		{
+			fprintf(stderr, "unknown encode \"%s\" in [%s]\n", value, section);
+			exit(1);
+		}
+	}
 	else if (strcmp(name, "stringify-define") == 0)
 	{
 		S.stringifyDefine = value;
 	}
+	else if (strcmp(name, "stats-define") == 0)
+	{
+		S.statsDefine = value;
+	}
 	else if (strcmp(name, "cpp-stringify") == 0)
 	{
 		S.cppStringifyDisable = strcmp(value, "yes") != 0;
@@ -440,6 +883,38 @@ int iniFieldHandler(void* data, const char* section, const char* name, const cha
 	{
 		S.bottomExprs.push_back(value);
 	}
+	else if (strcmp(name, "mode") == 0)
+	{
+		if (strcmp(value, "header-only") == 0) S.headerOnly = true;
+		else if (strcmp(value, "source") == 0) S.headerOnly = false;
+		else
+		{
+			fprintf(stderr, "unknown mode \"%s\"\n", value);
+			exit(1);
+		}
+	}
+	else if (strcmp(name, "profile") == 0)
+	{
+		if (strcmp(value, "size") == 0) S.sizeProfile = true;
+		else if (strcmp(value, "speed") == 0) S.sizeProfile = false;
+		else
+		{
+			fprintf(stderr, "unknown profile \"%s\"\n", value);
+			exit(1);
+		}
+	}
+	else if (strcmp(name, "table-section") == 0)
+	{
+		S.tableSection = value;
+	}
+	else if (strcmp(name, "weights") == 0)
+	{
+		S.weightsFile = value;
+	}
+	else if (strcmp(name, "tune-cache") == 0)
+	{
+		S.tuneCache = value;
+	}
 	else if (strcmp(name, "src-dir") == 0)
 	{
 		S.srcDir = value;
@@ -456,12 +931,33 @@ int iniFieldHandler(void* data, const char* section, const char* name, const cha
 			exit(1);
 		}
 		
-		S.currentSection().entries().push_back(Entry(value));
+		S.currentSection().entries().push_back(Entry(value, S.strings));
 	}
 	
 	return 0;
 }
 
+//
+// ini_parse_mapped() callback: fields, the bulk of a file, go from the
+// mapping straight into the arena; other keys take iniFieldHandler
+//
+int iniSpanHandler(void *data, ini_span section, ini_span name, ini_span value)
+{
+	struct statefields &S = *reinterpret_cast<struct statefields *>(data);
+	std::string_view sectionView(section.p, section.len);
+	std::string_view nameView(name.p, name.len);
+	std::string_view valueView(value.p, value.len);
+	
+	if (nameView == "field" && sectionView == S.curSection && S.sections.size() > 0)
+	{
+		logf("[%.*s]%.*s=%.*s\n", (int)section.len, section.p, (int)name.len, name.p, (int)value.len, value.p);
+		S.currentSection().entries().push_back(Entry(valueView, S.strings));
+		return 0;
+	}
+	
+	return iniFieldHandler(data, std::string(sectionView).c_str(), std::string(nameView).c_str(), std::string(valueView).c_str());
+}
+
 void ltrim(std::string &s) 
 {
     s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) {
@@ -510,346 +1006,3149 @@ std::string tryReadOldHeaderGuardMacroName(const std::string &filename)
 }
 
 
-int file_compare(const std::string &file1, const std::string &file2)
+//
+// Write "len" bytes to "fileName" unless it already holds exactly them.
+// The old file is compared through mmap; a new one is written to a sibling
+// and renamed over it, so readers never see a partial file. A symlinked
+// output is written through the link and the old file mode is kept.
+// Return true if the file was written.
+//
+bool writeIfChanged(const std::string &fileName, const char *data, size_t len)
 {
-	FILE *pf1 = fopen(file1.c_str(), "r");
-	FILE *pf2 = fopen(file2.c_str(), "r");
-	
-	int result = 0;
-	bool haveResult = false;
-	
-	if (pf1 == nullptr && pf2 != nullptr) { result = -1; haveResult = true; }
-	else if (pf1 != nullptr && pf2 == nullptr) { result = 1; haveResult = true; }
-	else if (pf1 == nullptr && pf2 == nullptr) { result = 0; haveResult = true; }
+	// the sibling goes next to the file the link points to
+	std::string targetName = fileName;
+	char *real = realpath(fileName.c_str(), nullptr);
+	if (real)
+	{
+		targetName = real;
+		free(real);
+	}
 	
-	while (!haveResult) {
-		int ch1 = fgetc(pf1);
-		int ch2 = fgetc(pf2);
+	struct stat st;
+	bool exists = false;
+	int fd = open(targetName.c_str(), O_RDONLY);
+	if (fd >= 0)
+	{
+		bool same = false;
+		exists = fstat(fd, &st) == 0;
+		if (exists && (size_t)st.st_size == len)
+		{
+			if (len == 0)
+			{
+				same = true;
+			}
+			else
+			{
+				void *old = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (old != MAP_FAILED)
+				{
+					same = memcmp(old, data, len) == 0;
+					munmap(old, len);
+				}
+			}
+		}
+		close(fd);
 		
-		if (ch1 == EOF && ch2 != EOF) { result = -1; haveResult = true; }
-		else if (ch1 != EOF && ch2 == EOF) { result = 1; haveResult = true; }
-		else if (ch1 == EOF && ch2 == EOF) { result = 0; haveResult = true; }
-		else if (ch1 < ch2) { result = -1; haveResult = true; }
-		else if (ch1 > ch2) { result = 1; haveResult = true; }
+		if (same) return false;
 	}
 	
-	if (pf1 != nullptr) fclose(pf1);
-	if (pf2 != nullptr) fclose(pf2);
-	
-	return result;
-}
-
-void makeEnumFiles(struct statefields &S)
-{
-	srand(time(0));
-	std::string title;
-	extractFileTitle(S.fileName, title);
+	static std::atomic<unsigned> siblingCount(0);
+	std::string tmpName = targetName + "." + std::to_string(getpid()) + "." + std::to_string(siblingCount++) + ".tmp";
 	
-	unsigned titleBufSize = title.size();
-	char titleBuf[titleBufSize +1];
-	memset(titleBuf, 0, titleBufSize +1);
-	for (unsigned i = 0, titleBufPos = 0; i < titleBufSize; ++i)
+	fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd < 0 || (exists && fchmod(fd, st.st_mode & 07777) != 0))
 	{
-		char ch = title[i];
-		if (isalnum(ch) || ch == '_')
+		fprintf(stderr, "can not write \"%s\": %s\n", tmpName.c_str(), strerror(errno));
+		if (fd >= 0)
 		{
-			titleBuf[titleBufPos++] = ch;
+			close(fd);
+			remove(tmpName.c_str());
 		}
+		exit(1);
 	}
 	
-	if (S.headerGuard.empty())
+	for (size_t off = 0; off < len; )
 	{
-		S.headerGuard = titleBuf;
-		
-		unsigned rndLen = 16;
-		char rndBuf[rndLen +1];
-		memset(rndBuf, 0, rndLen +1);
-		for (unsigned i = 0; i < rndLen; ++i)
+		ssize_t n = write(fd, data + off, len - off);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0)
 		{
-			rndBuf[i] = ('a' + (rand() % ('z'-'a')));
+			fprintf(stderr, "can not write \"%s\": %s\n", tmpName.c_str(), strerror(errno));
+			close(fd);
+			remove(tmpName.c_str());
+			exit(1);
 		}
-		
-		S.headerGuard += std::string("_") + std::string(rndBuf);
+		off += n;
 	}
+	close(fd);
 	
-	std::string cHeaderFileName = title + "." + S.cHeader;
-	
-	std::string cHeaderActualFileName = tmpnam(nullptr);
-	std::string cSourceFileName = tmpnam(nullptr);
-	
-	std::string final_cHeaderActualFileName = S.includeDir + cHeaderFileName;
-	std::string final_cSourceFileName = S.srcDir + title + "." + S.cSource;
+	if (rename(tmpName.c_str(), targetName.c_str()) != 0)
+	{
+		fprintf(stderr, "can not rename \"%s\" to \"%s\": %s\n", tmpName.c_str(), targetName.c_str(), strerror(errno));
+		remove(tmpName.c_str());
+		exit(1);
+	}
 	
-	std::string oldHGMacroName = tryReadOldHeaderGuardMacroName(final_cHeaderActualFileName);
+	return true;
+}
+
+//
+// Name used to refer to an enum field in generated code; scoped enums
+// need the enum name as qualifier.
+//
+std::string qualifiedName(const Section &section, const Entry &entry)
+{
+	if (section.type().find("class") != std::string::npos || section.type().find("struct") != std::string::npos)
+	{
+		return section.name() + "::" + std::string(entry.name());
+	}
+	
+	return std::string(entry.name());
+}
+
+//
+// Position of the last "op" outside parentheses, or npos. A "|" that is
+// part of "||" does not count.
+//
+size_t findTopLevelOp(const std::string &str, const std::string &op)
+{
+	size_t found = std::string::npos;
+	int depth = 0;
+	
+	for (size_t i = 0; i < str.size(); ++i)
+	{
+		if (str[i] == '(') ++depth;
+		else if (str[i] == ')') --depth;
+		else if (depth == 0 && str.compare(i, op.size(), op) == 0)
+		{
+			if (op == "|" && ((i > 0 && str[i-1] == '|') || (i + 1 < str.size() && str[i+1] == '|'))) continue;
+			found = i;
+			i += op.size() - 1;
+		}
+	}
+	
+	return found;
+}
+
+//
+// True if the outer parentheses of "str" enclose all of it, e.g. "(1)"
+// but not "(1)|(2)"
+//
+bool isParenthesized(const std::string &str)
+{
+	if (str.size() < 2 || str[0] != '(' || str[str.size()-1] != ')') return false;
+	
+	int depth = 0;
+	for (size_t i = 0; i + 1 < str.size(); ++i)
+	{
+		if (str[i] == '(') ++depth;
+		else if (str[i] == ')' && --depth == 0) return false;
+	}
+	
+	return true;
+}
+
+//
+// Evaluate a field value expression. Handles integer literals, references
+// to fields declared earlier in the same section and the flag operators
+// "a | b" and "a << b".
+//
+bool evalValueExpr(const std::string &expr, const Section &section, const std::vector<long long> &values, long long &result)
+{
+	std::string str = trim(expr);
+	
+	while (isParenthesized(str))
+	{
+		str = trim(str.substr(1, str.size()-2));
+	}
+	
+	// "|" binds weaker than "<<"; both are left associative
+	static const char *const binaryOps[] = { "|", "<<" };
+	for (const char *op : binaryOps)
+	{
+		size_t pos = findTopLevelOp(str, op);
+		if (pos == std::string::npos) continue;
+		
+		long long lhs, rhs;
+		if (!evalValueExpr(str.substr(0, pos), section, values, lhs) || !evalValueExpr(str.substr(pos + strlen(op)), section, values, rhs)) return false;
+		
+		if (op[0] == '|')
+		{
+			result = lhs | rhs;
+			return true;
+		}
+		
+		// no negative operands and no bits shifted out of 64
+		if (lhs < 0 || rhs < 0 || rhs > 63 || ((unsigned long long)lhs << rhs) >> rhs != (unsigned long long)lhs) return false;
+		result = (long long)((unsigned long long)lhs << rhs);
+		return true;
+	}
+	
+	if (str.size() > 0 && (str[0] == '-' || str[0] == '+'))
+	{
+		long long val;
+		if (!evalValueExpr(str.substr(1), section, values, val)) return false;
+		result = str[0] == '-' ? (long long)(0ULL - (unsigned long long)val) : val;
+		return true;
+	}
+	
+	if (str.empty())
+	{
+		return false;
+	}
+	
+	if (isdigit((unsigned char)str[0]))
+	{
+		char *end = nullptr;
+		errno = 0;
+		unsigned long long val = strtoull(str.c_str(), &end, 0);
+		if (errno != 0) return false;
+		
+		// integer suffixes
+		while (*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L') ++end;
+		if (*end != '\0') return false;
+		
+		result = (long long)val;
+		return true;
+	}
+	
+	for (unsigned i = 0; i < values.size(); ++i)
+	{
+		const Entry &entry = section.entries()[i];
+		if (str == entry.name() || str == qualifiedName(section, entry))
+		{
+			result = values[i];
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+bool resolveSectionValues(const Section &section, std::vector<long long> &values)
+{
+	values.clear();
+	long long next = 0;
+	
+	for (auto &entry : section.entries())
+	{
+		long long value = next;
+		if (entry.valueExpr().size() > 0 && !evalValueExpr(std::string(entry.valueExpr()), section, values, value))
+		{
+			values.clear();
+			return false;
+		}
+		
+		values.push_back(value);
+		next = value + 1;
+	}
+	
+	return true;
+}
+
+//
+// Smallest fixed width integer type holding [minValue, maxValue]
+//
+const char *intTypeFor(long long minValue, long long maxValue)
+{
+	if (minValue >= 0)
+	{
+		if (maxValue <= 0xff) return "uint8_t";
+		if (maxValue <= 0xffff) return "uint16_t";
+		if (maxValue <= 0xffffffffLL) return "uint32_t";
+		return "uint64_t";
+	}
+	
+	if (minValue >= -0x80 && maxValue <= 0x7f) return "int8_t";
+	if (minValue >= -0x8000 && maxValue <= 0x7fff) return "int16_t";
+	if (minValue >= -0x80000000LL && maxValue <= 0x7fffffffLL) return "int32_t";
+	return "int64_t";
+}
+
+//
+// Entry indices by descending weight (;@hot=N or weights=); declaration
+// order among equal weights, so without weights this is 0..n-1
+//
+std::vector<unsigned> hotOrder(const Section &section)
+{
+	std::vector<unsigned> order(section.entries().size());
+	for (unsigned i = 0; i < order.size(); ++i) order[i] = i;
+	
+	std::stable_sort(order.begin(), order.end(), [&section](unsigned a, unsigned b) { return section.entries()[a].weight() > section.entries()[b].weight(); });
+	return order;
+}
+
+//
+// Pick the cheapest exact XxxToIndex implementation for a section
+//
+void planIndexLookup(const struct statefields &S, const Section &section, struct indexplan &plan)
+{
+	unsigned count = section.entries().size();
+	
+	plan = indexplan();
+	plan.resolved = count > 0 && resolveSectionValues(section, plan.values);
+	
+	bool contiguous = plan.resolved;
+	unsigned long long range = 0;
+	
+	if (plan.resolved)
+	{
+		plan.minValue = *std::min_element(plan.values.begin(), plan.values.end());
+		plan.maxValue = *std::max_element(plan.values.begin(), plan.values.end());
+		range = (unsigned long long)plan.maxValue - (unsigned long long)plan.minValue + 1;
+		
+		for (unsigned i = 0; i < count; ++i)
+		{
+			if (plan.values[i] != plan.minValue + (long long)i) contiguous = false;
+			
+			if (std::find(plan.values.begin(), plan.values.begin() + i, plan.values[i]) == plan.values.begin() + i)
+			{
+				plan.firstIndex.push_back(i);
+			}
+		}
+	}
+	
+	bool compact = plan.resolved && range <= 65536 && range <= 4ULL * count + 16;
+	plan.compact = compact;
+	
+	int strategy = section.lookup();
+	if (!plan.resolved && strategy != LOOKUP_LINEAR && strategy != LOOKUP_AUTO)
+	{
+		fprintf(stderr, "warning: [%s] values can not be evaluated, lookup=%s ignored\n", section.name().c_str(), g_lookupStrategyNames[strategy]);
+		strategy = LOOKUP_AUTO;
+	}
+	else if ((strategy == LOOKUP_OFFSET && !contiguous) || (strategy == LOOKUP_TABLE && range > 65536))
+	{
+		fprintf(stderr, "warning: [%s] values do not allow lookup=%s\n", section.name().c_str(), g_lookupStrategyNames[strategy]);
+		strategy = LOOKUP_AUTO;
+	}
+	
+	if (strategy == LOOKUP_AUTO)
+	{
+		if (!plan.resolved) strategy = LOOKUP_LINEAR;
+		else if (contiguous) strategy = LOOKUP_OFFSET;
+		else if (S.sizeProfile) strategy = LOOKUP_LINEAR;
+		else if (compact) strategy = LOOKUP_TABLE;
+		else strategy = LOOKUP_SWITCH;
+	}
+	
+	plan.strategy = strategy;
+	
+	//
+	// weighted search order over the first field of each value, so the
+	// public index of fields sharing a value does not change
+	//
+	unsigned long long totalWeight = 0;
+	for (auto &entry : section.entries()) totalWeight += entry.weight();
+	plan.weighted = totalWeight > 0;
+	
+	if (plan.weighted && plan.resolved)
+	{
+		// a value weighs what all its fields weigh together
+		std::vector<unsigned long long> valueWeight(count, 0);
+		for (unsigned i : plan.firstIndex)
+		{
+			for (unsigned j = i; j < count; ++j)
+			{
+				if (plan.values[j] == plan.values[i]) valueWeight[i] += section.entries()[j].weight();
+			}
+		}
+		
+		plan.searchOrder = plan.firstIndex;
+		std::stable_sort(plan.searchOrder.begin(), plan.searchOrder.end(), [&valueWeight](unsigned a, unsigned b) { return valueWeight[a] > valueWeight[b]; });
+		
+		// values carrying at least 1/8 of the traffic get a compare of their own
+		if (strategy == LOOKUP_SWITCH || strategy == LOOKUP_BINARY)
+		{
+			for (unsigned i : plan.searchOrder)
+			{
+				if (plan.hot.size() >= 4 || valueWeight[i] * 8 < totalWeight) break;
+				plan.hot.push_back(i);
+			}
+		}
+		
+		logf("%s: hottest field %s\n", section.name().c_str(), section.entries()[plan.searchOrder[0]].name().data());
+	}
+	else if (plan.weighted)
+	{
+		logf("%s: values not known at generation time, ToIndex keeps declaration order\n", section.name().c_str());
+	}
+	else
+	{
+		plan.searchOrder = plan.firstIndex;
+	}
+	
+	if (plan.resolved)
+	{
+		logf("%s: ToIndex lookup=%s (%u fields, values %lld..%lld)\n", section.name().c_str(), g_lookupStrategyNames[strategy], count, plan.minValue, plan.maxValue);
+	}
+	else
+	{
+		logf("%s: ToIndex lookup=%s (%u fields, values not known at generation time)\n", section.name().c_str(), g_lookupStrategyNames[strategy], count);
+	}
+}
+
+//
+// Minimal perfect hash over a set of keys ("hash and displace"): keys are
+// spread over buckets by the upper half of a FNV-1a hash; each bucket gets
+// a displacement that moves all its keys to distinct, still free slots.
+// There are exactly as many slots as keys.
+//
+struct perfecthash
+{
+	uint64_t seed;
+	unsigned buckets;
+	std::vector<unsigned> disp;       // per bucket
+	std::vector<unsigned> slotIndex;  // per slot: enum index of the key
+	
+	perfecthash()
+	{
+		seed = 0;
+		buckets = 0;
+	}
+};
+
+uint64_t phHash(const char *str, size_t len, uint64_t h)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		h = (h ^ (unsigned char)str[i]) * 1099511628211ULL;
+	}
+	return h;
+}
+
+unsigned phSlot(uint64_t h, uint64_t d, unsigned n)
+{
+	uint64_t m = h + d * 0x9e3779b97f4a7c15ULL;
+	m ^= m >> 33;
+	m *= 0xff51afd7ed558ccdULL;
+	m ^= m >> 33;
+	return (unsigned)(m % n);
+}
+
+bool buildPerfectHash(const std::vector<std::string> &keys, const std::vector<unsigned> &keyIndex, struct perfecthash &ph)
+{
+	unsigned n = keys.size();
+	uint64_t seed = 14695981039346656037ULL;
+	
+	for (unsigned attempt = 0; attempt < 32 && n > 0; ++attempt, seed = seed * 6364136223846793005ULL + 1442695040888963407ULL)
+	{
+		ph = perfecthash();
+		ph.seed = seed;
+		ph.buckets = (n + 3) / 4;
+		ph.disp.assign(ph.buckets, 0);
+		ph.slotIndex.assign(n, 0);
+		
+		std::vector<uint64_t> hashes(n);
+		std::vector<std::vector<unsigned>> bucketKeys(ph.buckets);
+		for (unsigned i = 0; i < n; ++i)
+		{
+			hashes[i] = phHash(keys[i].c_str(), keys[i].size(), seed);
+			bucketKeys[(unsigned)(hashes[i] >> 32) % ph.buckets].push_back(i);
+		}
+		
+		std::vector<unsigned> order(ph.buckets);
+		for (unsigned b = 0; b < ph.buckets; ++b) order[b] = b;
+		std::stable_sort(order.begin(), order.end(), [&bucketKeys](unsigned a, unsigned b) { return bucketKeys[a].size() > bucketKeys[b].size(); });
+		
+		std::vector<bool> used(n, false);
+		bool ok = true;
+		
+		for (unsigned b : order)
+		{
+			const std::vector<unsigned> &bk = bucketKeys[b];
+			if (bk.empty()) break;
+			
+			bool placed = false;
+			for (uint64_t d = 0; d < (1u << 20) && !placed; ++d)
+			{
+				std::vector<unsigned> slots;
+				placed = true;
+				for (unsigned k : bk)
+				{
+					unsigned slot = phSlot(hashes[k], d, n);
+					if (used[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end())
+					{
+						placed = false;
+						break;
+					}
+					slots.push_back(slot);
+				}
+				
+				if (placed)
+				{
+					ph.disp[b] = (unsigned)d;
+					for (unsigned j = 0; j < bk.size(); ++j)
+					{
+						used[slots[j]] = true;
+						ph.slotIndex[slots[j]] = keyIndex[bk[j]];
+					}
+				}
+			}
+			
+			if (!placed)
+			{
+				ok = false;
+				break;
+			}
+		}
+		
+		if (ok) return true;
+	}
+	
+	return false;
+}
+
+//
+// Emit the displacement and slot tables of a perfect hash, named
+// g_<name><tag>HashDisp / g_<name><tag>HashSlot
+//
+void writePerfectHashTables(FILE *fp, const struct statefields &S, const char *name, const char *tag, const struct perfecthash &ph)
+{
+	unsigned maxDisp = *std::max_element(ph.disp.begin(), ph.disp.end());
+	
+	fprintf(fp, "%s%s g_%s%sHashDisp[%u] = {", S.localTable().c_str(), intTypeFor(0, maxDisp), name, tag, ph.buckets);
+	for (unsigned i = 0; i < ph.buckets; ++i)
+	{
+		fprintf(fp, "%s%u,", (i % 16) == 0 ? "\n\t" : " ", ph.disp[i]);
+	}
+	fprintf(fp, "\n};\n");
+	
+	fprintf(fp, "%s%s g_%s%sHashSlot[%u] = {", S.localTable().c_str(), intTypeFor(0, ph.slotIndex.size()), name, tag, (unsigned)ph.slotIndex.size());
+	for (unsigned i = 0; i < ph.slotIndex.size(); ++i)
+	{
+		fprintf(fp, "%s%u,", (i % 16) == 0 ? "\n\t" : " ", ph.slotIndex[i]);
+	}
+	fprintf(fp, "\n};\n");
+}
+
+//
+// Emit "unsigned <var> = <slot table>[hash of str/len]"
+//
+void writePerfectHashProbe(FILE *fp, const char *indent, const char *name, const char *tag, const struct perfecthash &ph, const char *var)
+{
+	fprintf(fp, "%suint64_t h = __%sHash(str, len, %lluULL);\n", indent, name, (unsigned long long)ph.seed);
+	fprintf(fp, "%sunsigned %s = g_%s%sHashSlot[__%sHashSlot(h, g_%s%sHashDisp[(unsigned)(h >> 32) %% %uu], %uu)];\n",
+		indent, var, name, tag, name, name, tag, ph.buckets, (unsigned)ph.slotIndex.size());
+}
+
+//
+// ASCII lower case copy of a field name, as produced by the generated
+// word-at-a-time fold
+//
+std::string asciiFold(std::string_view str)
+{
+	std::string result(str);
+	for (auto &ch : result)
+	{
+		if (ch >= 'A' && ch <= 'Z') ch += 'a' - 'A';
+	}
+	return result;
+}
+
+//
+// All field names of a section as one NUL-separated string blob; with
+// offset and length tables it needs no relocations and lives in .rodata
+//
+void writeStringPool(FILE *fp, const struct statefields &S, const Section &section, const char *tag, bool folded)
+{
+	const char *name = section.name().c_str();
+	
+	// hot names first so they share cache lines
+	fprintf(fp, "%schar g_%s%sStringPool[] =", S.localTable().c_str(), name, tag);
+	for (unsigned i : hotOrder(section))
+	{
+		const Entry &entry = section.entries()[i];
+		fprintf(fp, "\n\t\"%s\\0\"", folded ? asciiFold(entry.name()).c_str() : entry.name().data());
+	}
+	fprintf(fp, ";\n");
+}
+
+void writeStringPoolIndex(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	std::vector<unsigned> offsets(count), lengths(count);
+	unsigned offset = 0, maxLen = 0;
+	
+	// pool is laid out in hot order; the tables stay in index order
+	for (unsigned i : hotOrder(section))
+	{
+		const Entry &entry = section.entries()[i];
+		offsets[i] = offset;
+		lengths[i] = entry.name().size();
+		offset += entry.name().size() + 1;
+		maxLen = std::max(maxLen, (unsigned)entry.name().size());
+	}
+	
+	fprintf(fp, "%s%s g_%sStringOffset[%u] = {", S.localTable().c_str(), intTypeFor(0, offset), name, count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		fprintf(fp, "%s%u,", (i % 16) == 0 ? "\n\t" : " ", offsets[i]);
+	}
+	fprintf(fp, "\n};\n");
+	
+	fprintf(fp, "%s%s g_%sStringLength[%u] = {", S.localTable().c_str(), intTypeFor(0, maxLen), name, count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		fprintf(fp, "%s%u,", (i % 16) == 0 ? "\n\t" : " ", lengths[i]);
+	}
+	fprintf(fp, "\n};\n");
+}
+
+void nameLengthRange(const Section &section, size_t &minLen, size_t &maxLen)
+{
+	minLen = 0;
+	maxLen = 0;
+	for (unsigned i = 0; i < section.entries().size(); ++i)
+	{
+		size_t len = section.entries()[i].name().size();
+		minLen = i == 0 ? len : std::min(minLen, len);
+		maxLen = std::max(maxLen, len);
+	}
+}
+
+//
+// Prefix shared by all field names, e.g. "SQ_" or "Color": the longest
+// common prefix cut back to its last '_', or to a lower/upper case boundary
+// if it has none. Every name keeps a non-empty suffix.
+//
+std::string commonPrefix(const Section &section)
+{
+	auto &entries = section.entries();
+	
+	if (section.prefixSet())
+	{
+		for (auto &entry : entries)
+		{
+			if (entry.name().size() <= section.prefix().size() || entry.name().compare(0, section.prefix().size(), section.prefix()) != 0)
+			{
+				fprintf(stderr, "[%s] field %s does not start with prefix \"%s\"\n", section.name().c_str(), entry.name().data(), section.prefix().c_str());
+				exit(1);
+			}
+		}
+		return section.prefix();
+	}
+	
+	if (entries.size() == 0) return "";
+	
+	size_t len = entries[0].name().size();
+	for (auto &entry : entries)
+	{
+		// no prefix can leave an empty name a non-empty suffix
+		if (entry.name().empty()) return "";
+		
+		size_t i = 0;
+		while (i < len && i < entry.name().size() && entry.name()[i] == entries[0].name()[i]) ++i;
+		len = std::min(len, i);
+		
+		// keep a suffix
+		if (len >= entry.name().size()) len = entry.name().size() - 1;
+	}
+	
+	std::string prefix(entries[0].name().substr(0, len));
+	size_t underscore = prefix.find_last_of('_');
+	if (underscore != std::string::npos) return prefix.substr(0, underscore + 1);
+	
+	// camel case: the suffix starts upper case right after a lower case letter
+	while (len > 0)
+	{
+		bool boundary = islower((unsigned char)entries[0].name()[len - 1]);
+		for (auto &entry : entries)
+		{
+			boundary = boundary && isupper((unsigned char)entry.name()[len]);
+		}
+		if (boundary) break;
+		--len;
+	}
+	return std::string(entries[0].name().substr(0, len));
+}
+
+void writeFromString(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	
+	struct perfecthash ph, foldPh, suffixPh, suffixFoldPh;
+	bool useHash = false, useSuffixHash = false;
+	size_t minLen, maxLen;
+	nameLengthRange(section, minLen, maxLen);
+	std::string prefix = commonPrefix(section);
+	unsigned prefixLen = prefix.size();
+	
+	bool wantHash = section.stringLookup() == STRLOOKUP_HASH || (section.stringLookup() == STRLOOKUP_AUTO && !S.sizeProfile);
+	
+	if (wantHash && count > 0)
+	{
+		std::vector<std::string> keys, foldKeys;
+		std::vector<unsigned> keyIndex, foldKeyIndex;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			keys.push_back(std::string(section.entries()[i].name()));
+			keyIndex.push_back(i);
+			
+			// names equal but for case resolve to the first one, like the linear search
+			std::string folded = asciiFold(keys[i]);
+			if (std::find(foldKeys.begin(), foldKeys.end(), folded) == foldKeys.end())
+			{
+				foldKeys.push_back(folded);
+				foldKeyIndex.push_back(i);
+			}
+		}
+		
+		useHash = buildPerfectHash(keys, keyIndex, ph) && buildPerfectHash(foldKeys, foldKeyIndex, foldPh);
+		if (!useHash)
+		{
+			fprintf(stderr, "warning: [%s] no perfect hash found, FromString falls back to linear search\n", name);
+		}
+		
+		// the same over the names without their common prefix
+		std::vector<std::string> suffixKeys, suffixFoldKeys;
+		std::vector<unsigned> suffixFoldKeyIndex;
+		for (unsigned i = 0; i < count && prefixLen > 0; ++i)
+		{
+			suffixKeys.push_back(keys[i].substr(prefixLen));
+			
+			std::string folded = asciiFold(suffixKeys[i]);
+			if (std::find(suffixFoldKeys.begin(), suffixFoldKeys.end(), folded) == suffixFoldKeys.end())
+			{
+				suffixFoldKeys.push_back(folded);
+				suffixFoldKeyIndex.push_back(i);
+			}
+		}
+		
+		useSuffixHash = useHash && prefixLen > 0 && buildPerfectHash(suffixKeys, keyIndex, suffixPh) && buildPerfectHash(suffixFoldKeys, suffixFoldKeyIndex, suffixFoldPh);
+	}
+	
+	logf("%s: FromString lookup=%s\n", name, useHash ? "hash" : "linear");
+	
+	// fold buffer: whole words, large enough for the longest name
+	unsigned foldBufLen = ((unsigned)maxLen + 7) & ~7u;
+	
+	if (useHash)
+	{
+		fprintf(fp, "%suint64_t __%sHash(const char *str, size_t len, uint64_t h)\n{\n", S.localFn(), name);
+		fprintf(fp, "\tfor (size_t i = 0; i < len; ++i) { h = (h ^ (unsigned char)str[i]) * 1099511628211ULL; }\n");
+		fprintf(fp, "\treturn h;\n");
+		fprintf(fp, "}\n");
+		fprintf(fp, "%sunsigned __%sHashSlot(uint64_t h, uint64_t d, unsigned n)\n{\n", S.localFn(), name);
+		fprintf(fp, "\tuint64_t m = h + d * 0x9e3779b97f4a7c15ULL;\n");
+		fprintf(fp, "\tm ^= m >> 33; m *= 0xff51afd7ed558ccdULL; m ^= m >> 33;\n");
+		fprintf(fp, "\treturn (unsigned)(m %% n);\n");
+		fprintf(fp, "}\n");
+		writePerfectHashTables(fp, S, name, "", ph);
+		
+		//
+		// case folding: ASCII 'A'..'Z' get bit 0x20 set, eight bytes at a time
+		// and without branches; bytes >= 0x80 are left alone
+		//
+		fprintf(fp, "%svoid __%sFold(char *buf, size_t len)\n{\n", S.localFn(), name);
+		fprintf(fp, "\tfor (size_t i = 0; i < len; i += 8)\n\t{\n");
+		fprintf(fp, "\t\tuint64_t w, x;\n");
+		fprintf(fp, "\t\tmemcpy(&w, buf + i, 8);\n");
+		fprintf(fp, "\t\tx = w & 0x7f7f7f7f7f7f7f7fULL;\n");
+		fprintf(fp, "\t\tx = ((x + 0x3f3f3f3f3f3f3f3fULL) ^ (x + 0x2525252525252525ULL)) & ~w & 0x8080808080808080ULL;\n");
+		fprintf(fp, "\t\tw |= x >> 2;\n");
+		fprintf(fp, "\t\tmemcpy(buf + i, &w, 8);\n");
+		fprintf(fp, "\t}\n");
+		fprintf(fp, "}\n");
+		writeStringPool(fp, S, section, "Fold", true);
+		writePerfectHashTables(fp, S, name, "Fold", foldPh);
+		
+		//
+		// exact and case-insensitive lookup of str[0..len): one hash, one compare
+		//
+		fprintf(fp, "%sint __%sLookup(const char *str, size_t len, %s *presult)\n{\n", S.localFn(), name, name);
+		fprintf(fp, "\tif (len < %u || len > %u) return -1;\n", (unsigned)minLen, (unsigned)maxLen);
+		writePerfectHashProbe(fp, "\t", name, "", ph, "ix");
+		fprintf(fp, "\tif (g_%sStringLength[ix] != len || memcmp(str, g_%sStringPool + g_%sStringOffset[ix], len) != 0) return -1;\n", name, name, name);
+		fprintf(fp, "\t*presult = (%s)g_%sValueArray[ix];\n", name, name);
+		fprintf(fp, "\treturn 0;\n");
+		fprintf(fp, "}\n");
+		
+		fprintf(fp, "%sint __%sLookupFold(const char *str, size_t len, %s *presult)\n{\n", S.localFn(), name, name);
+		fprintf(fp, "\tif (len < %u || len > %u) return -1;\n", (unsigned)minLen, (unsigned)maxLen);
+		fprintf(fp, "\tchar buf[%u] = { 0 };\n", foldBufLen);
+		fprintf(fp, "\tmemcpy(buf, str, len);\n");
+		fprintf(fp, "\t__%sFold(buf, len);\n", name);
+		fprintf(fp, "\tstr = buf;\n");
+		writePerfectHashProbe(fp, "\t", name, "Fold", foldPh, "ix");
+		fprintf(fp, "\tif (g_%sStringLength[ix] != len || memcmp(str, g_%sFoldStringPool + g_%sStringOffset[ix], len) != 0) return -1;\n", name, name, name);
+		fprintf(fp, "\t*presult = (%s)g_%sValueArray[ix];\n", name, name);
+		fprintf(fp, "\treturn 0;\n");
+		fprintf(fp, "}\n");
+	}
+	
+	if (useSuffixHash)
+	{
+		//
+		// lookup of a name without its common prefix "%s"
+		//
+		writePerfectHashTables(fp, S, name, "Suffix", suffixPh);
+		writePerfectHashTables(fp, S, name, "SuffixFold", suffixFoldPh);
+		
+		fprintf(fp, "%sint __%sLookupSuffix(const char *str, size_t len, %s *presult)\n{\n", S.localFn(), name, name);
+		fprintf(fp, "\tif (len < %u || len > %u) return -1;\n", (unsigned)minLen - prefixLen, (unsigned)maxLen - prefixLen);
+		writePerfectHashProbe(fp, "\t", name, "Suffix", suffixPh, "ix");
+		fprintf(fp, "\tif (g_%sStringLength[ix] != len + %u || memcmp(str, g_%sStringPool + g_%sStringOffset[ix] + %u, len) != 0) return -1;\n", name, prefixLen, name, name, prefixLen);
+		fprintf(fp, "\t*presult = (%s)g_%sValueArray[ix];\n", name, name);
+		fprintf(fp, "\treturn 0;\n");
+		fprintf(fp, "}\n");
+		
+		fprintf(fp, "%sint __%sLookupSuffixFold(const char *str, size_t len, %s *presult)\n{\n", S.localFn(), name, name);
+		fprintf(fp, "\tif (len < %u || len > %u) return -1;\n", (unsigned)minLen - prefixLen, (unsigned)maxLen - prefixLen);
+		fprintf(fp, "\tchar buf[%u] = { 0 };\n", foldBufLen);
+		fprintf(fp, "\tmemcpy(buf, str, len);\n");
+		fprintf(fp, "\t__%sFold(buf, len);\n", name);
+		fprintf(fp, "\tstr = buf;\n");
+		writePerfectHashProbe(fp, "\t", name, "SuffixFold", suffixFoldPh, "ix");
+		fprintf(fp, "\tif (g_%sStringLength[ix] != len + %u || memcmp(str, g_%sFoldStringPool + g_%sStringOffset[ix] + %u, len) != 0) return -1;\n", name, prefixLen, name, name, prefixLen);
+		fprintf(fp, "\t*presult = (%s)g_%sValueArray[ix];\n", name, name);
+		fprintf(fp, "\treturn 0;\n");
+		fprintf(fp, "}\n");
+	}
+	
+	// the linear search tries names by weight
+	std::vector<unsigned> order = hotOrder(section);
+	bool nameOrder = false;
+	for (unsigned i = 0; i < count; ++i) nameOrder = nameOrder || order[i] != i;
+	if (nameOrder)
+	{
+		fprintf(fp, "%s%s g_%sNameSearchOrder[%u] = {", S.localTable().c_str(), intTypeFor(0, count), name, count);
+		for (unsigned k = 0; k < count; ++k)
+		{
+			fprintf(fp, "%s%u,", (k % 16) == 0 ? "\n\t" : " ", order[k]);
+		}
+		fprintf(fp, "\n};\n");
+	}
+	
+	//
+	// from length-delimited string; never reads str[len] or beyond
+	//
+	if (S.statsDefine.size() > 0)
+	{
+		// counted wrapper below
+		fprintf(fp, "%sint __%sFromStringN(const char *str, size_t len, %s *presult, bool ignoreCase, int ignorePrefixLen)\n{\n", S.localFn(), name, name);
+	}
+	else
+	{
+		fprintf(fp, "%sint %sFromStringN(const char *str, size_t len, %s *presult, bool ignoreCase, int ignorePrefixLen)\n{\n", S.externFn(), name, name);
+	}
+	
+	if (useHash)
+	{
+		fprintf(fp, "\tif (ignorePrefixLen == 0)\n\t{\n");
+		fprintf(fp, "\t\treturn ignoreCase ? __%sLookupFold(str, len, presult) : __%sLookup(str, len, presult);\n", name, name);
+		fprintf(fp, "\t}\n");
+	}
+	
+	if (useSuffixHash)
+	{
+		fprintf(fp, "\tif (ignorePrefixLen == %u)\n\t{\n", prefixLen);
+		fprintf(fp, "\t\treturn ignoreCase ? __%sLookupSuffixFold(str, len, presult) : __%sLookupSuffix(str, len, presult);\n", name, name);
+		fprintf(fp, "\t}\n");
+	}
+	
+	fprintf(fp, "\tsize_t fullLen = len + (size_t)ignorePrefixLen;\n");
+	fprintf(fp, "\tif (ignorePrefixLen < 0 || fullLen < %u || fullLen > %u) return -1;\n", (unsigned)minLen, (unsigned)maxLen);
+	if (nameOrder)
+	{
+		fprintf(fp, "\tfor (unsigned k = 0; k < %u; ++k)\n\t{\n", count);
+		fprintf(fp, "\t\tunsigned i = g_%sNameSearchOrder[k];\n", name);
+	}
+	else
+	{
+		fprintf(fp, "\tfor (unsigned i = 0; i < %u; ++i)\n\t{\n", count);
+	}
+	fprintf(fp, "\t\tif (g_%sStringLength[i] != fullLen) continue;\n", name);
+	fprintf(fp, "\t\tconst char *checkStr = g_%sStringPool + g_%sStringOffset[i] + ignorePrefixLen;\n", name, name);
+	fprintf(fp, "\t\tbool equal = true;\n");
+	fprintf(fp, "\t\tif (ignoreCase)\n\t\t{\n");
+	fprintf(fp, "\t\t\tfor (size_t j = 0; j < len && equal; ++j) equal = tolower((unsigned char)str[j]) == tolower((unsigned char)checkStr[j]);\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\telse\n\t\t{\n");
+	fprintf(fp, "\t\t\tequal = memcmp(str, checkStr, len) == 0;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\tif (equal)\n\t\t{\n");
+	fprintf(fp, "\t\t\t*presult = (%s)g_%sValueArray[i]; return 0;\n", name, name);
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\treturn -1;\n");
+	fprintf(fp, "}\n");
+	
+	if (S.statsDefine.size() > 0)
+	{
+		fprintf(fp, "%sint %sFromStringN(const char *str, size_t len, %s *presult, bool ignoreCase, int ignorePrefixLen)\n{\n", S.externFn(), name, name);
+		fprintf(fp, "\tint r = __%sFromStringN(str, len, presult, ignoreCase, ignorePrefixLen);\n", name);
+		fprintf(fp, "\t__%sSTAT(%u, r == 0 ? __%sIndexOf(*presult) : -1);\n", name, STAT_FROMSTRING, name);
+		fprintf(fp, "\treturn r;\n");
+		fprintf(fp, "}\n");
+	}
+	
+	//
+	// from string
+	//
+	fprintf(fp, "%sint %sFromString(const char *str, %s *presult, bool ignoreCase, int ignorePrefixLen)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tsize_t len = 0;\n");
+	if (S.statsDefine.size() > 0)
+	{
+		fprintf(fp, "\twhile (str[len] != (char)0) { if (++len > %u) { __%sSTAT(%u, -1); return -1; } }\n", (unsigned)maxLen, name, STAT_FROMSTRING);
+	}
+	else
+	{
+		fprintf(fp, "\twhile (str[len] != (char)0) { if (++len > %u) return -1; }\n", (unsigned)maxLen);
+	}
+	fprintf(fp, "\treturn %sFromStringN(str, len, presult, ignoreCase, ignorePrefixLen);\n", name);
+	fprintf(fp, "}\n");
+	
+	//
+	// with or without the common prefix; a name whose suffix starts with the
+	// prefix again is tried both ways. With stats the tries go to the
+	// uncounted lookup, so one call counts once.
+	//
+	bool stats = S.statsDefine.size() > 0;
+	std::string lookupN = stats ? std::string("__") + name + "FromStringN" : std::string(name) + "FromStringN";
+	if (stats)
+	{
+		// counted wrapper below
+		fprintf(fp, "%sint __%sFromStringAnyN(const char *str, size_t len, %s *presult, bool ignoreCase)\n{\n", S.localFn(), name, name);
+	}
+	else
+	{
+		fprintf(fp, "%sint %sFromStringAnyN(const char *str, size_t len, %s *presult, bool ignoreCase)\n{\n", S.externFn(), name, name);
+	}
+	if (prefixLen > 0)
+	{
+		fprintf(fp, "\tif (len > %u)\n\t{\n", prefixLen);
+		fprintf(fp, "\t\tbool prefixed = true;\n");
+		fprintf(fp, "\t\tfor (unsigned i = 0; i < %u && prefixed; ++i)\n\t\t{\n", prefixLen);
+		fprintf(fp, "\t\t\tprefixed = ignoreCase ? tolower((unsigned char)str[i]) == tolower((unsigned char)\"%s\"[i]) : str[i] == \"%s\"[i];\n", prefix.c_str(), prefix.c_str());
+		fprintf(fp, "\t\t}\n");
+		fprintf(fp, "\t\tif (prefixed && %s(str + %u, len - %u, presult, ignoreCase, %u) == 0) return 0;\n", lookupN.c_str(), prefixLen, prefixLen, prefixLen);
+		fprintf(fp, "\t}\n");
+	}
+	fprintf(fp, "\treturn %s(str, len, presult, ignoreCase, %u);\n", lookupN.c_str(), prefixLen);
+	fprintf(fp, "}\n");
+	
+	if (stats)
+	{
+		fprintf(fp, "%sint %sFromStringAnyN(const char *str, size_t len, %s *presult, bool ignoreCase)\n{\n", S.externFn(), name, name);
+		fprintf(fp, "\tint r = __%sFromStringAnyN(str, len, presult, ignoreCase);\n", name);
+		fprintf(fp, "\t__%sSTAT(%u, r == 0 ? __%sIndexOf(*presult) : -1);\n", name, STAT_FROMSTRING, name);
+		fprintf(fp, "\treturn r;\n");
+		fprintf(fp, "}\n");
+	}
+	
+	fprintf(fp, "%sint %sFromStringAny(const char *str, %s *presult, bool ignoreCase)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tsize_t len = 0;\n");
+	if (stats)
+	{
+		fprintf(fp, "\twhile (str[len] != (char)0) { if (++len > %u) { __%sSTAT(%u, -1); return -1; } }\n", (unsigned)maxLen, name, STAT_FROMSTRING);
+	}
+	else
+	{
+		fprintf(fp, "\twhile (str[len] != (char)0) { if (++len > %u) return -1; }\n", (unsigned)maxLen);
+	}
+	fprintf(fp, "\treturn %sFromStringAnyN(str, len, presult, ignoreCase);\n", name);
+	fprintf(fp, "}\n");
+}
+
+//
+// Value array and the value -> index mapping (__XxxIndexOf) used by both
+// XxxToIndex and Xxx_GetThraits
+//
+void writeIndexCore(FILE *fp, const struct statefields &S, const Section &section, const struct indexplan &plan)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	
+	if (S.sizeProfile && plan.resolved)
+	{
+		// plain numbers in the narrowest type instead of enum sized values
+		fprintf(fp, "%s%s g_%sValueArray[%u] = {\n", S.localTable().c_str(), intTypeFor(plan.minValue, plan.maxValue), name, count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			fprintf(fp, "\t%lld, /* %s */\n", plan.values[i], section.entries()[i].name().data());
+		}
+		fprintf(fp, "};\n");
+	}
+	else
+	{
+		fprintf(fp, "%s%s g_%sValueArray[%u] = \n{\n", S.localTable().c_str(), name, name, count);
+		for (auto &entry : section.entries())
+		{
+			fprintf(fp, "\t%s,\n", qualifiedName(section, entry).c_str());
+		}
+		fprintf(fp, "};\n");
+	}
+	
+	if (plan.strategy == LOOKUP_TABLE)
+	{
+		unsigned range = (unsigned)(plan.maxValue - plan.minValue + 1);
+		
+		// one extra -1 entry lets the batch lookup clamp instead of branch
+		std::vector<int> table(range + 1, -1);
+		for (unsigned i : plan.firstIndex)
+		{
+			table[plan.values[i] - plan.minValue] = i;
+		}
+		
+		fprintf(fp, "%s%s g_%sIndexTable[%u] = {", S.localTable().c_str(), intTypeFor(-1, count), name, range + 1);
+		for (unsigned i = 0; i <= range; ++i)
+		{
+			fprintf(fp, "%s%d,", (i % 16) == 0 ? "\n\t" : " ", table[i]);
+		}
+		fprintf(fp, "\n};\n");
+	}
+	else if (plan.strategy == LOOKUP_BINARY)
+	{
+		std::vector<unsigned> sorted = plan.firstIndex;
+		std::sort(sorted.begin(), sorted.end(), [&plan](unsigned a, unsigned b) { return plan.values[a] < plan.values[b]; });
+		
+		fprintf(fp, "%s%s g_%sSortedValueArray[%u] = {\n", S.localTable().c_str(), intTypeFor(plan.minValue, plan.maxValue), name, (unsigned)sorted.size());
+		for (unsigned i : sorted)
+		{
+			fprintf(fp, "\t%lldLL,\n", plan.values[i]);
+		}
+		fprintf(fp, "};\n");
+		fprintf(fp, "%s%s g_%sSortedIndexArray[%u] = {\n", S.localTable().c_str(), intTypeFor(0, count), name, (unsigned)sorted.size());
+		for (unsigned i : sorted)
+		{
+			fprintf(fp, "\t%u,\n", i);
+		}
+		fprintf(fp, "};\n");
+	}
+	
+	bool hotScan = plan.strategy == LOOKUP_LINEAR && plan.weighted && plan.resolved;
+	if (hotScan)
+	{
+		fprintf(fp, "%s%s g_%sSearchOrder[%u] = {", S.localTable().c_str(), intTypeFor(0, count), name, (unsigned)plan.searchOrder.size());
+		for (unsigned k = 0; k < plan.searchOrder.size(); ++k)
+		{
+			fprintf(fp, "%s%u,", (k % 16) == 0 ? "\n\t" : " ", plan.searchOrder[k]);
+		}
+		fprintf(fp, "\n};\n");
+	}
+	
+	fprintf(fp, "%sint __%sIndexOf(%s value)\n", S.localConstexprFn(), name, name);
+	fprintf(fp, "{\n");
+	
+	for (unsigned i : plan.hot)
+	{
+		fprintf(fp, "\tif (value == %s) return %u;\n", qualifiedName(section, section.entries()[i]).c_str(), i);
+	}
+	
+	switch (plan.strategy)
+	{
+	case LOOKUP_OFFSET:
+		fprintf(fp, "\tunsigned long long ix = (unsigned long long)((long long)value - (%lldLL));\n", plan.minValue);
+		fprintf(fp, "\treturn ix < %uULL ? (int)ix : -1;\n", count);
+		break;
+		
+	case LOOKUP_TABLE:
+		fprintf(fp, "\tunsigned long long off = (unsigned long long)((long long)value - (%lldLL));\n", plan.minValue);
+		fprintf(fp, "\treturn off < %lluULL ? g_%sIndexTable[off] : -1;\n", (unsigned long long)(plan.maxValue - plan.minValue + 1), name);
+		break;
+		
+	case LOOKUP_BINARY:
+		fprintf(fp, "\tlong long v = (long long)value;\n");
+		fprintf(fp, "\tunsigned lo = 0, hi = %u;\n", (unsigned)plan.firstIndex.size());
+		fprintf(fp, "\twhile (lo < hi) {\n");
+		fprintf(fp, "\t\tunsigned mid = (lo + hi) / 2;\n");
+		fprintf(fp, "\t\tif (g_%sSortedValueArray[mid] < v) lo = mid + 1; else hi = mid;\n", name);
+		fprintf(fp, "\t}\n");
+		fprintf(fp, "\treturn (lo < %u && g_%sSortedValueArray[lo] == v) ? (int)g_%sSortedIndexArray[lo] : -1;\n", (unsigned)plan.firstIndex.size(), name, name);
+		break;
+		
+	case LOOKUP_SWITCH:
+		fprintf(fp, "\tswitch (value)\n\t{\n");
+		for (unsigned i : plan.firstIndex)
+		{
+			fprintf(fp, "\tcase %s: return %u;\n", qualifiedName(section, section.entries()[i]).c_str(), i);
+		}
+		fprintf(fp, "\tdefault: return -1;\n");
+		fprintf(fp, "\t}\n");
+		break;
+		
+	default:
+		if (hotScan)
+		{
+			fprintf(fp, "\tfor (unsigned k = 0; k < %uu; ++k) {\n", (unsigned)plan.searchOrder.size());
+			fprintf(fp, "\t\tunsigned i = g_%sSearchOrder[k];\n", name);
+			fprintf(fp, "\t\tif ((long long)value == (long long)g_%sValueArray[i]) { return (int)i; }\n", name);
+			fprintf(fp, "\t}\n");
+			fprintf(fp, "\treturn -1;\n");
+			break;
+		}
+		fprintf(fp, "\tfor (unsigned i = 0; i < %uu; ++i) {\n", count);
+		fprintf(fp, "\t\tif ((long long)value == (long long)g_%sValueArray[i]) { return (int)i; }\n", name);
+		fprintf(fp, "\t}\n");
+		fprintf(fp, "\treturn -1;\n");
+		break;
+	}
+	
+	fprintf(fp, "}\n");
+}
+
+//
+// stats-define: call/miss counters per function (each on its own cache
+// line) and hit counters per index, bumped with relaxed atomics. With the
+// macro undefined __XxxSTAT expands to nothing.
+//
+void writeStatsCore(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	const char *storage = S.headerOnly ? "inline " : "static ";
+	
+	if (S.statsDefine.empty()) return;
+	
+	fprintf(fp, "#if defined(%s)\n", S.statsDefine.c_str());
+	fprintf(fp, "%senumg_stat_counter g_%sStatCalls[%u];\n", storage, name, STAT_COUNT);
+	fprintf(fp, "%senumg_stat_counter g_%sStatMisses[%u];\n", storage, name, STAT_COUNT);
+	fprintf(fp, "%suint64_t g_%sStatHits[%u];\n", storage, name, count);
+	fprintf(fp, "%svoid __%sStat(unsigned fn, int ix)\n{\n", S.localConstexprFn(), name);
+	if (S.headerOnly)
+	{
+		// keeps the constexpr functions usable in constant expressions
+		fprintf(fp, "\tif (__builtin_is_constant_evaluated()) return;\n");
+	}
+	fprintf(fp, "\tENUMG_STAT_ADD(g_%sStatCalls[fn].n);\n", name);
+	fprintf(fp, "\tif (ix < 0) ENUMG_STAT_ADD(g_%sStatMisses[fn].n);\n", name);
+	fprintf(fp, "\telse ENUMG_STAT_ADD(g_%sStatHits[ix]);\n", name);
+	fprintf(fp, "}\n");
+	fprintf(fp, "#define __%sSTAT(fn, ix) __%sStat(fn, ix)\n", name, name);
+	fprintf(fp, "#else\n");
+	fprintf(fp, "#define __%sSTAT(fn, ix) ((void)0)\n", name);
+	fprintf(fp, "#endif\n");
+}
+
+//
+// Report in the weights= format: "Enum FIELD hits" per field, function
+// counters as '#' comments
+//
+void writeDumpStats(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	
+	if (S.statsDefine.empty()) return;
+	
+	fprintf(fp, "#if defined(%s)\n", S.statsDefine.c_str());
+	fprintf(fp, "%svoid %sDumpStats(FILE *fp)\n{\n", S.externFn(), name);
+	fprintf(fp, "\tunsigned i;\n");
+	fprintf(fp, "\tfprintf(fp, \"# enumg stats %s\\n\");\n", name);
+	for (unsigned fn = 0; fn < STAT_COUNT; ++fn)
+	{
+		fprintf(fp, "\tfprintf(fp, \"# %s calls %%llu misses %%llu\\n\", (unsigned long long)ENUMG_STAT_LOAD(g_%sStatCalls[%u].n), (unsigned long long)ENUMG_STAT_LOAD(g_%sStatMisses[%u].n));\n", g_statFunctionNames[fn], name, fn, name, fn);
+	}
+	fprintf(fp, "\tfor (i = 0; i < %u; ++i)\n\t{\n", count);
+	fprintf(fp, "\t\tfprintf(fp, \"%s %%s %%llu\\n\", g_%sStringPool + g_%sStringOffset[i], (unsigned long long)ENUMG_STAT_LOAD(g_%sStatHits[i]));\n", name, name, name, name);
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "%svoid %sResetStats(void)\n{\n", S.externFn(), name);
+	fprintf(fp, "\tmemset(g_%sStatCalls, 0, sizeof(g_%sStatCalls));\n", name, name);
+	fprintf(fp, "\tmemset(g_%sStatMisses, 0, sizeof(g_%sStatMisses));\n", name, name);
+	fprintf(fp, "\tmemset(g_%sStatHits, 0, sizeof(g_%sStatHits));\n", name, name);
+	fprintf(fp, "}\n");
+	fprintf(fp, "#endif\n");
+}
+
+//
+// Name of a value into a caller buffer, std::to_chars style; values that
+// are not part of the enum are written as Xxx(0x...)
+//
+void writeToChars(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned nameLen = section.name().size();
+	
+	fprintf(fp, "%schar *%sToChars(char *first, char *last, %s value)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tint ix = __%sIndexOf(value);\n", name);
+	fprintf(fp, "\tif (ix >= 0)\n\t{\n");
+	fprintf(fp, "\t\tsize_t len = g_%sStringLength[ix];\n", name);
+	fprintf(fp, "\t\tif ((size_t)(last - first) < len) return NULL;\n");
+	fprintf(fp, "\t\tmemcpy(first, g_%sStringPool + g_%sStringOffset[ix], len);\n", name, name);
+	fprintf(fp, "\t\treturn first + len;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\telse\n\t{\n");
+	fprintf(fp, "\t\tchar buf[24];\n");
+	fprintf(fp, "\t\tchar *p = buf + sizeof(buf);\n");
+	fprintf(fp, "\t\tlong long v = (long long)value;\n");
+	fprintf(fp, "\t\tunsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;\n");
+	fprintf(fp, "\t\t*--p = ')';\n");
+	fprintf(fp, "\t\tdo { *--p = \"0123456789abcdef\"[u & 15]; u >>= 4; } while (u != 0);\n");
+	fprintf(fp, "\t\t*--p = 'x'; *--p = '0';\n");
+	fprintf(fp, "\t\tif (v < 0) *--p = '-';\n");
+	fprintf(fp, "\t\t*--p = '(';\n");
+	fprintf(fp, "\t\tsize_t numLen = (size_t)(buf + sizeof(buf) - p);\n");
+	fprintf(fp, "\t\tif ((size_t)(last - first) < %u + numLen) return NULL;\n", nameLen);
+	fprintf(fp, "\t\tmemcpy(first, \"%s\", %u);\n", name, nameLen);
+	fprintf(fp, "\t\tmemcpy(first + %u, p, numLen);\n", nameLen);
+	fprintf(fp, "\t\treturn first + %u + numLen;\n", nameLen);
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+}
+
+//
+// Emit a {fmt}/std::format formatter specialization body; "lib" is the
+// namespace ("std" or "fmt"). Spec: {} or {:s} name, {:d} decimal, {:x} hex.
+//
+void writeFormatterSpecialization(FILE *fp, const Section &section, const char *lib)
+{
+	const char *name = section.name().c_str();
+	
+	fprintf(fp, "namespace %s\n{\n", lib);
+	fprintf(fp, "template <> struct formatter<%s, char>\n{\n", name);
+	fprintf(fp, "\tchar presentation = 's';\n");
+	fprintf(fp, "\ttemplate <class ParseContext>\n");
+	fprintf(fp, "\tconstexpr auto parse(ParseContext &ctx)\n\t{\n");
+	fprintf(fp, "\t\tauto it = ctx.begin();\n");
+	fprintf(fp, "\t\tif (it != ctx.end() && (*it == 's' || *it == 'd' || *it == 'x')) presentation = *it++;\n");
+	fprintf(fp, "\t\tif (it != ctx.end() && *it != '}') throw format_error(\"invalid format spec for %s\");\n", name);
+	fprintf(fp, "\t\treturn it;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\ttemplate <class FormatContext>\n");
+	fprintf(fp, "\tauto format(%s value, FormatContext &ctx) const\n\t{\n", name);
+	fprintf(fp, "\t\tif (presentation == 'd') return %s::format_to(ctx.out(), \"{}\", (long long)value);\n", lib);
+	fprintf(fp, "\t\tif (presentation == 'x') return %s::format_to(ctx.out(), \"{:#x}\", (long long)value);\n", lib);
+	fprintf(fp, "\t\tchar buf[%sToCharsMaxLength];\n", name);
+	fprintf(fp, "\t\tsize_t len = 0;\n");
+	fprintf(fp, "\t\tconst char *str = %sToStringN(value, &len);\n", name);
+	fprintf(fp, "\t\tif (str == nullptr) { len = (size_t)(%sToChars(buf, buf + sizeof(buf), value) - buf); str = buf; }\n", name);
+	fprintf(fp, "\t\tauto out = ctx.out();\n");
+	fprintf(fp, "\t\tfor (size_t i = 0; i < len; ++i) *out++ = str[i];\n");
+	fprintf(fp, "\t\treturn out;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "};\n");
+	fprintf(fp, "}\n");
+}
+
+//
+// operator<<, std::formatter and fmt::formatter; names are written straight
+// from the length-annotated string pool
+//
+void writeFormatters(FILE *fp, const Section &section)
+{
+	const char *name = section.name().c_str();
+	int flags = section.formatters();
+	
+	if (flags == 0) return;
+	
+	fprintf(fp, "#if defined(__cplusplus)\n");
+	
+	if (flags & FORMATTER_OSTREAM)
+	{
+		fprintf(fp, "#include <ostream>\n");
+		fprintf(fp, "inline std::ostream &operator<<(std::ostream &os, %s value)\n{\n", name);
+		fprintf(fp, "\tchar buf[%sToCharsMaxLength];\n", name);
+		fprintf(fp, "\tsize_t len = 0;\n");
+		fprintf(fp, "\tconst char *str = %sToStringN(value, &len);\n", name);
+		fprintf(fp, "\tif (str == nullptr) { len = (size_t)(%sToChars(buf, buf + sizeof(buf), value) - buf); str = buf; }\n", name);
+		fprintf(fp, "\treturn os.write(str, (std::streamsize)len);\n");
+		fprintf(fp, "}\n");
+	}
+	
+	if (flags & FORMATTER_STD)
+	{
+		fprintf(fp, "#if defined(__has_include)\n");
+		fprintf(fp, "\t#if __has_include(<format>) && __cplusplus >= 202002L\n");
+		fprintf(fp, "\t\t#include <format>\n");
+		fprintf(fp, "\t#endif\n");
+		fprintf(fp, "#endif\n");
+		fprintf(fp, "#if defined(__cpp_lib_format)\n");
+		writeFormatterSpecialization(fp, section, "std");
+		fprintf(fp, "#endif\n");
+	}
+	
+	if (flags & FORMATTER_FMT)
+	{
+		fprintf(fp, "#include <fmt/format.h>\n");
+		writeFormatterSpecialization(fp, section, "fmt");
+	}
+	
+	fprintf(fp, "#endif\n");
+}
+
+//
+// XxxMap<T>: flat array with one slot per enum index; XxxSet: bitset over
+// the enum indices. constexpr in header-only mode.
+//
+void writeContainers(FILE *fp, const struct statefields &S, const Section &section, const struct indexplan &plan)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	unsigned words = (count + 63) / 64;
+	const char *cx = S.headerOnly ? "constexpr " : "";
+	
+	if (!section.containers() || count == 0) return;
+	
+	// fields sharing a value only occupy the index of the first one
+	std::vector<unsigned long long> allBits(words, 0);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (!plan.resolved || std::find(plan.firstIndex.begin(), plan.firstIndex.end(), i) != plan.firstIndex.end())
+		{
+			allBits[i / 64] |= 1ULL << (i % 64);
+		}
+	}
+	
+	fprintf(fp, "#if defined(__cplusplus)\n");
+	
+	fprintf(fp, "template <class T>\n");
+	fprintf(fp, "class %sMap\n{\n", name);
+	fprintf(fp, "public:\n");
+	fprintf(fp, "\tstatic constexpr unsigned capacity() { return %u; }\n", count);
+	fprintf(fp, "\tstatic %s%s keyAt(unsigned index) { return %sFromIndex(index); }\n", cx, name, name);
+	fprintf(fp, "\t%sbool contains(%s key) const { return %sToIndex(key) >= 0; }\n", cx, name, name);
+	fprintf(fp, "\t// \"key\" must be a field of the enum\n");
+	fprintf(fp, "\t%sT &operator[](%s key) { return m_values[%sToIndex(key)]; }\n", cx, name, name);
+	fprintf(fp, "\t%sconst T &operator[](%s key) const { return m_values[%sToIndex(key)]; }\n", cx, name, name);
+	fprintf(fp, "\t%sT *find(%s key) { int ix = %sToIndex(key); return ix < 0 ? nullptr : &m_values[ix]; }\n", cx, name, name);
+	fprintf(fp, "\t%sconst T *find(%s key) const { int ix = %sToIndex(key); return ix < 0 ? nullptr : &m_values[ix]; }\n", cx, name, name);
+	fprintf(fp, "\t%svoid fill(const T &value) { for (unsigned i = 0; i < %u; ++i) m_values[i] = value; }\n", cx, count);
+	fprintf(fp, "\t%sT *begin() { return m_values; }\n", cx);
+	fprintf(fp, "\t%sT *end() { return m_values + %u; }\n", cx, count);
+	fprintf(fp, "\t%sconst T *begin() const { return m_values; }\n", cx);
+	fprintf(fp, "\t%sconst T *end() const { return m_values + %u; }\n", cx, count);
+	fprintf(fp, "private:\n");
+	fprintf(fp, "\tT m_values[%u] = {};\n", count);
+	fprintf(fp, "};\n");
+	
+	fprintf(fp, "class %sSet\n{\n", name);
+	fprintf(fp, "public:\n");
+	fprintf(fp, "\tclass iterator\n\t{\n");
+	fprintf(fp, "\tpublic:\n");
+	fprintf(fp, "\t\t%siterator(const %sSet *set, unsigned index) : m_set(set), m_index(set->next(index)) { }\n", cx, name);
+	fprintf(fp, "\t\t%s%s operator*() const { return %sFromIndex(m_index); }\n", cx, name, name);
+	fprintf(fp, "\t\t%siterator &operator++() { m_index = m_set->next(m_index + 1); return *this; }\n", cx);
+	fprintf(fp, "\t\t%sbool operator==(const iterator &other) const { return m_index == other.m_index; }\n", cx);
+	fprintf(fp, "\t\t%sbool operator!=(const iterator &other) const { return m_index != other.m_index; }\n", cx);
+	fprintf(fp, "\tprivate:\n");
+	fprintf(fp, "\t\tconst %sSet *m_set;\n", name);
+	fprintf(fp, "\t\tunsigned m_index;\n");
+	fprintf(fp, "\t};\n");
+	fprintf(fp, "\tconstexpr %sSet() : m_bits{} { }\n", name);
+	fprintf(fp, "\t%s%sSet(std::initializer_list<%s> values) : m_bits{} { for (%s value : values) insert(value); }\n", cx, name, name, name);
+	fprintf(fp, "\tstatic ENUMG_CONSTEXPR14 %sSet all() { %sSet set; ", name, name);
+	for (unsigned w = 0; w < words; ++w)
+	{
+		fprintf(fp, "set.m_bits[%u] = 0x%llxULL; ", w, allBits[w]);
+	}
+	fprintf(fp, "return set; }\n");
+	fprintf(fp, "\t%sbool insert(%s value) { int ix = %sToIndex(value); if (ix < 0) return false; m_bits[ix / 64] |= 1ULL << (ix %% 64); return true; }\n", cx, name, name);
+	fprintf(fp, "\t%svoid erase(%s value) { int ix = %sToIndex(value); if (ix >= 0) m_bits[ix / 64] &= ~(1ULL << (ix %% 64)); }\n", cx, name, name);
+	fprintf(fp, "\t%sbool contains(%s value) const { int ix = %sToIndex(value); return ix >= 0 && ((m_bits[ix / 64] >> (ix %% 64)) & 1) != 0; }\n", cx, name, name);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 unsigned count() const\n\t{\n");
+	fprintf(fp, "\t\tunsigned n = 0;\n");
+	fprintf(fp, "\t\tfor (unsigned w = 0; w < %u; ++w)\n\t\t{\n", words);
+	fprintf(fp, "\t\t\tuint64_t x = m_bits[w];\n");
+	fprintf(fp, "\t\t\tx = x - ((x >> 1) & 0x5555555555555555ULL);\n");
+	fprintf(fp, "\t\t\tx = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);\n");
+	fprintf(fp, "\t\t\tx = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;\n");
+	fprintf(fp, "\t\t\tn += (unsigned)((x * 0x0101010101010101ULL) >> 56);\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\treturn n;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\tENUMG_CONSTEXPR14 bool empty() const { for (unsigned w = 0; w < %u; ++w) if (m_bits[w] != 0) return false; return true; }\n", words);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 %sSet &operator|=(const %sSet &other) { for (unsigned w = 0; w < %u; ++w) m_bits[w] |= other.m_bits[w]; return *this; }\n", name, name, words);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 %sSet &operator&=(const %sSet &other) { for (unsigned w = 0; w < %u; ++w) m_bits[w] &= other.m_bits[w]; return *this; }\n", name, name, words);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 %sSet &operator-=(const %sSet &other) { for (unsigned w = 0; w < %u; ++w) m_bits[w] &= ~other.m_bits[w]; return *this; }\n", name, name, words);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 %sSet operator|(const %sSet &other) const { %sSet set = *this; set |= other; return set; }\n", name, name, name);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 %sSet operator&(const %sSet &other) const { %sSet set = *this; set &= other; return set; }\n", name, name, name);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 %sSet operator-(const %sSet &other) const { %sSet set = *this; set -= other; return set; }\n", name, name, name);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 bool operator==(const %sSet &other) const { for (unsigned w = 0; w < %u; ++w) if (m_bits[w] != other.m_bits[w]) return false; return true; }\n", name, words);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 bool operator!=(const %sSet &other) const { return !(*this == other); }\n", name);
+	fprintf(fp, "\t%siterator begin() const { return iterator(this, 0); }\n", cx);
+	fprintf(fp, "\t%siterator end() const { return iterator(this, %u); }\n", cx, count);
+	fprintf(fp, "private:\n");
+	fprintf(fp, "\t// first set index at or after \"index\"; %u if none\n", count);
+	fprintf(fp, "\tENUMG_CONSTEXPR14 unsigned next(unsigned index) const\n\t{\n");
+	fprintf(fp, "\t\twhile (index < %u)\n\t\t{\n", count);
+	fprintf(fp, "\t\t\tuint64_t w = m_bits[index / 64] >> (index %% 64);\n");
+	fprintf(fp, "\t\t\tif (w == 0) { index = (index / 64 + 1) * 64; continue; }\n");
+	fprintf(fp, "\t\t\twhile ((w & 1) == 0) { w >>= 1; ++index; }\n");
+	fprintf(fp, "\t\t\treturn index;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\treturn %u;\n", count);
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\tuint64_t m_bits[%u];\n", words);
+	fprintf(fp, "};\n");
+	
+	fprintf(fp, "#endif\n");
+}
+
+//
+// flags=yes: every value must be zero, a single bit or a combination of
+// bits that single-bit fields name, e.g. O_AB=O_A|O_B
+//
+void validateFlags(const Section &section, const struct indexplan &plan)
+{
+	if (!section.flags()) return;
+	
+	if (!plan.resolved)
+	{
+		fprintf(stderr, "[%s] flags=yes requires values enumg can evaluate\n", section.name().c_str());
+		exit(1);
+	}
+	
+	unsigned long long bits = 0;
+	for (auto v : plan.values)
+	{
+		if (v > 0 && (v & (v - 1)) == 0) bits |= (unsigned long long)v;
+	}
+	
+	for (unsigned i = 0; i < plan.values.size(); ++i)
+	{
+		long long v = plan.values[i];
+		if (v < 0 || ((unsigned long long)v & ~bits) != 0)
+		{
+			fprintf(stderr, "[%s] flags=yes: %s = %lld is neither a power of two nor a combination of single-bit fields\n", section.name().c_str(), section.entries()[i].name().data(), v);
+			exit(1);
+		}
+	}
+}
+
+//
+// All bits named by the fields of a flags section
+//
+unsigned long long flagsMask(const struct indexplan &plan)
+{
+	unsigned long long mask = 0;
+	for (auto v : plan.values) mask |= (unsigned long long)v;
+	return mask;
+}
+
+//
+// Typed bitmask operators; "~" complements within the declared bits so the
+// result stays inside the range of the enum
+//
+void writeFlagsOperators(FILE *fp, const Section &section, const struct indexplan &plan)
+{
+	const char *name = section.name().c_str();
+	
+	if (!section.flags()) return;
+	
+	fprintf(fp, "#if defined(__cplusplus)\n");
+	fprintf(fp, "constexpr %s operator|(%s a, %s b) { return (%s)((unsigned long long)a | (unsigned long long)b); }\n", name, name, name, name);
+	fprintf(fp, "constexpr %s operator&(%s a, %s b) { return (%s)((unsigned long long)a & (unsigned long long)b); }\n", name, name, name, name);
+	fprintf(fp, "constexpr %s operator^(%s a, %s b) { return (%s)((unsigned long long)a ^ (unsigned long long)b); }\n", name, name, name, name);
+	fprintf(fp, "constexpr %s operator~(%s a) { return (%s)(~(unsigned long long)a & 0x%llxULL); }\n", name, name, name, flagsMask(plan));
+	fprintf(fp, "inline %s &operator|=(%s &a, %s b) { return a = a | b; }\n", name, name, name);
+	fprintf(fp, "inline %s &operator&=(%s &a, %s b) { return a = a & b; }\n", name, name, name);
+	fprintf(fp, "inline %s &operator^=(%s &a, %s b) { return a = a ^ b; }\n", name, name, name);
+	fprintf(fp, "#endif\n");
+}
+
+//
+// Length of the longest XxxFlagsToChars output: every name joined by '|',
+// single-bit name joined by '|', or the zero name, plus "|0x" and 16 hex
+// digits for unnamed bits
+//
+unsigned flagsToCharsMaxLength(const Section &section, const struct indexplan &plan)
+{
+	unsigned len = 0;
+	unsigned zeroLen = 1;
+	
+	for (auto i : plan.firstIndex)
+	{
+		long long v = plan.values[i];
+		unsigned nameLen = section.entries()[i].name().size();
+		if (v == 0) zeroLen = nameLen;
+		else if ((v & (v - 1)) == 0) len += nameLen + 1;
+	}
+	
+	return std::max(len + 18, zeroLen);
+}
+
+//
+// XxxFlagsToChars / XxxFlagsFromString(N)
+//
+void writeFlagsStrings(FILE *fp, const struct statefields &S, const Section &section, const struct indexplan &plan)
+{
+	const char *name = section.name().c_str();
+	
+	if (!section.flags()) return;
+	
+	// field index per bit; -1 for unnamed bits
+	int bitIndex[64];
+	int zeroIndex = -1;
+	int maxBit = 0;
+	std::fill(bitIndex, bitIndex + 64, -1);
+	for (auto i : plan.firstIndex)
+	{
+		unsigned long long v = (unsigned long long)plan.values[i];
+		if (v == 0)
+		{
+			zeroIndex = i;
+			continue;
+		}
+		
+		// combinations are written as their single bits
+		if ((v & (v - 1)) != 0) continue;
+		
+		int bit = 0;
+		while ((v >> bit) != 1) ++bit;
+		bitIndex[bit] = i;
+		maxBit = std::max(maxBit, bit);
+	}
+	
+	fprintf(fp, "%s%s g_%sFlagBitIndex[%d] = {", S.localTable().c_str(), intTypeFor(-1, section.entries().size()), name, maxBit + 1);
+	for (int bit = 0; bit <= maxBit; ++bit)
+	{
+		fprintf(fp, "%s%d", bit ? ", " : " ", bitIndex[bit]);
+	}
+	fprintf(fp, " };\n");
+	
+	fprintf(fp, "%sunsigned __%sFlagsCtz(uint64_t m)\n{\n", S.localFn(), name);
+	fprintf(fp, "#if defined(__GNUC__)\n");
+	fprintf(fp, "\treturn (unsigned)__builtin_ctzll(m);\n");
+	fprintf(fp, "#else\n");
+	// isolate the lowest bit and look it up through a de Bruijn sequence
+	const unsigned long long debruijn = 0x03f79d71b4cb0a89ULL;
+	unsigned debruijnBit[64];
+	for (unsigned bit = 0; bit < 64; ++bit)
+	{
+		debruijnBit[((1ULL << bit) * debruijn) >> 58] = bit;
+	}
+	fprintf(fp, "\tstatic const unsigned char debruijnBit[64] = {");
+	for (unsigned i = 0; i < 64; ++i)
+	{
+		fprintf(fp, "%s%u", i ? ", " : " ", debruijnBit[i]);
+	}
+	fprintf(fp, " };\n");
+	fprintf(fp, "\treturn debruijnBit[((m & (0 - m)) * 0x%llxULL) >> 58];\n", debruijn);
+	fprintf(fp, "#endif\n");
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%schar *%sFlagsToChars(char *first, char *last, %s value)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tuint64_t m = (uint64_t)value;\n");
+	fprintf(fp, "\t// drop the sign extension of narrower enums\n");
+	fprintf(fp, "\tif (sizeof(value) < sizeof(m)) m &= ((uint64_t)1 << (sizeof(value) * 8 %% 64)) - 1;\n");
+	fprintf(fp, "\tuint64_t rest = 0;\n");
+	fprintf(fp, "\tchar *p = first;\n");
+	fprintf(fp, "\tif (m == 0)\n\t{\n");
+	if (zeroIndex >= 0)
+	{
+		fprintf(fp, "\t\tif ((size_t)(last - p) < %u) return NULL;\n", (unsigned)section.entries()[zeroIndex].name().size());
+		fprintf(fp, "\t\tmemcpy(p, g_%sStringPool + g_%sStringOffset[%d], %u);\n", name, name, zeroIndex, (unsigned)section.entries()[zeroIndex].name().size());
+		fprintf(fp, "\t\treturn p + %u;\n", (unsigned)section.entries()[zeroIndex].name().size());
+	}
+	else
+	{
+		fprintf(fp, "\t\tif (last == p) return NULL;\n");
+		fprintf(fp, "\t\t*p = '0';\n");
+		fprintf(fp, "\t\treturn p + 1;\n");
+	}
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\twhile (m != 0)\n\t{\n");
+	fprintf(fp, "\t\tunsigned bit = __%sFlagsCtz(m);\n", name);
+	fprintf(fp, "\t\tint ix = bit < %d ? g_%sFlagBitIndex[bit] : -1;\n", maxBit + 1, name);
+	fprintf(fp, "\t\tm &= m - 1;\n");
+	fprintf(fp, "\t\tif (ix < 0)\n\t\t{\n");
+	fprintf(fp, "\t\t\trest |= (uint64_t)1 << bit;\n");
+	fprintf(fp, "\t\t\tcontinue;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\tsize_t len = g_%sStringLength[ix];\n", name);
+	fprintf(fp, "\t\tif ((size_t)(last - p) < len + (p != first)) return NULL;\n");
+	fprintf(fp, "\t\tif (p != first) *p++ = '|';\n");
+	fprintf(fp, "\t\tmemcpy(p, g_%sStringPool + g_%sStringOffset[ix], len);\n", name, name);
+	fprintf(fp, "\t\tp += len;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\tif (rest != 0)\n\t{\n");
+	fprintf(fp, "\t\tchar buf[18];\n");
+	fprintf(fp, "\t\tchar *q = buf + sizeof(buf);\n");
+	fprintf(fp, "\t\tdo { *--q = \"0123456789abcdef\"[rest & 15]; rest >>= 4; } while (rest != 0);\n");
+	fprintf(fp, "\t\t*--q = 'x'; *--q = '0';\n");
+	fprintf(fp, "\t\tsize_t numLen = (size_t)(buf + sizeof(buf) - q);\n");
+	fprintf(fp, "\t\tif ((size_t)(last - p) < numLen + (p != first)) return NULL;\n");
+	fprintf(fp, "\t\tif (p != first) *p++ = '|';\n");
+	fprintf(fp, "\t\tmemcpy(p, q, numLen);\n");
+	fprintf(fp, "\t\tp += numLen;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\treturn p;\n");
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%sint %sFlagsFromStringN(const char *str, size_t len, %s *presult, bool ignoreCase)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tconst char *p = str;\n");
+	fprintf(fp, "\tconst char *end = str + len;\n");
+	fprintf(fp, "\tuint64_t m = 0;\n");
+	fprintf(fp, "\tfor (;;)\n\t{\n");
+	fprintf(fp, "\t\twhile (p < end && *p == ' ') ++p;\n");
+	fprintf(fp, "\t\tconst char *b = p;\n");
+	fprintf(fp, "\t\twhile (p < end && *p != '|') ++p;\n");
+	fprintf(fp, "\t\tconst char *e = p;\n");
+	fprintf(fp, "\t\twhile (e > b && e[-1] == ' ') --e;\n");
+	fprintf(fp, "\t\tif (e == b) return -1;\n");
+	fprintf(fp, "\t\t%s v;\n", name);
+	fprintf(fp, "\t\tif (%sFromStringN(b, (size_t)(e - b), &v, ignoreCase, 0) == 0)\n\t\t{\n", name);
+	fprintf(fp, "\t\t\tm |= (uint64_t)v;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\telse if (*b >= '0' && *b <= '9')\n\t\t{\n");
+	fprintf(fp, "\t\t\t// numeric token, decimal or 0x hex\n");
+	fprintf(fp, "\t\t\tunsigned base = 10;\n");
+	fprintf(fp, "\t\t\tuint64_t n = 0;\n");
+	fprintf(fp, "\t\t\tif (e - b > 2 && b[0] == '0' && (b[1] == 'x' || b[1] == 'X')) { base = 16; b += 2; }\n");
+	fprintf(fp, "\t\t\tfor (; b < e; ++b)\n\t\t\t{\n");
+	fprintf(fp, "\t\t\t\tunsigned d = (unsigned)(*b - '0');\n");
+	fprintf(fp, "\t\t\t\tif (base == 16 && d > 9) d = (unsigned)((*b | 0x20) - 'a') + 10;\n");
+	fprintf(fp, "\t\t\t\tif (d >= base) return -1;\n");
+	fprintf(fp, "\t\t\t\tif (n > (~(uint64_t)0 - d) / base) return -1;\n");
+	fprintf(fp, "\t\t\t\tn = n * base + d;\n");
+	fprintf(fp, "\t\t\t}\n");
+	fprintf(fp, "\t\t\tm |= n;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\telse\n\t\t{\n");
+	fprintf(fp, "\t\t\treturn -1;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\tif (p == end) break;\n");
+	fprintf(fp, "\t\t++p;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\t// bits no field names are not values of the enum, see operator~\n");
+	fprintf(fp, "\tif ((m & ~(uint64_t)0x%llxULL) != 0) return -1;\n", flagsMask(plan));
+	fprintf(fp, "\t*presult = (%s)m;\n", name);
+	fprintf(fp, "\treturn 0;\n");
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%sint %sFlagsFromString(const char *str, %s *presult, bool ignoreCase)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\treturn %sFlagsFromStringN(str, strlen(str), presult, ignoreCase);\n", name);
+	fprintf(fp, "}\n");
+}
+
+//
+// dispatch=yes: handler table with one slot per enum index and the default
+// handler in the last slot, so dispatch is an index lookup, one select and
+// an indirect call. C++ also gets XxxVisit, which calls the handler object
+// with std::integral_constant<Xxx, field> so each case can be inlined.
+//
+void writeDispatchDecl(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	
+	if (!section.dispatch()) return;
+	
+	fprintf(fp, "typedef int (*%sHandler)(%s value, void *context);\n", name, name);
+	fprintf(fp, "typedef struct %sDispatchTable\n{\n", name);
+	fprintf(fp, "\t%sHandler handlers[%u]; // by xxxToIndex; last is the default handler\n", name, count + 1);
+	fprintf(fp, "} %sDispatchTable;\n", name);
+	fprintf(fp, "%svoid %sDispatchInit(%sDispatchTable *table, %sHandler defaultHandler);\n", S.externFn(), name, name, name);
+	fprintf(fp, "%sint %sDispatchSet(%sDispatchTable *table, %s value, %sHandler handler);\n", S.externFn(), name, name, name, name);
+	fprintf(fp, "%sint %sDispatch(const %sDispatchTable *table, %s value, void *context)\n{\n", S.localFn(), name, name, name);
+	fprintf(fp, "\tint ix = %sToIndex(value);\n", name);
+	fprintf(fp, "\treturn table->handlers[ix < 0 ? %u : ix](value, context);\n", count);
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "#if defined(__cplusplus) && __cplusplus >= 201402L\n");
+	fprintf(fp, "template <%s V, class Handler>\n", name);
+	fprintf(fp, "inline decltype(auto) __%sVisitThunk(Handler &handler, %s)\n{\n", name, name);
+	fprintf(fp, "\treturn handler(std::integral_constant<%s, V>());\n", name);
+	fprintf(fp, "}\n");
+	fprintf(fp, "template <class Handler>\n");
+	fprintf(fp, "inline decltype(auto) __%sVisitDefault(Handler &handler, %s value)\n{\n", name, name);
+	fprintf(fp, "\treturn handler(value);\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// \"handler\" is called with std::integral_constant<%s, field> for fields\n", name);
+	fprintf(fp, "// and with the plain value otherwise; every call must return the same type\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "template <class Handler>\n");
+	fprintf(fp, "inline decltype(auto) %sVisit(%s value, Handler &&handler)\n{\n", name, name);
+	fprintf(fp, "\ttypedef decltype(handler(value)) (*thunk)(Handler &, %s);\n", name);
+	fprintf(fp, "\tstatic constexpr thunk thunks[%u] =\n\t{\n", count + 1);
+	for (auto &entry : section.entries())
+	{
+		fprintf(fp, "\t\t&__%sVisitThunk<%s, Handler>,\n", name, qualifiedName(section, entry).c_str());
+	}
+	fprintf(fp, "\t\t&__%sVisitDefault<Handler>\n", name);
+	fprintf(fp, "\t};\n");
+	fprintf(fp, "\tint ix = %sToIndex(value);\n", name);
+	fprintf(fp, "\treturn thunks[ix < 0 ? %u : ix](handler, value);\n", count);
+	fprintf(fp, "}\n");
+	fprintf(fp, "#endif\n");
+}
+
+void writeDispatchDef(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	
+	if (!section.dispatch()) return;
+	
+	fprintf(fp, "%svoid %sDispatchInit(%sDispatchTable *table, %sHandler defaultHandler)\n{\n", S.externFn(), name, name, name);
+	fprintf(fp, "\tunsigned i;\n");
+	fprintf(fp, "\tfor (i = 0; i < %u; ++i) table->handlers[i] = defaultHandler;\n", count + 1);
+	fprintf(fp, "}\n");
+	fprintf(fp, "%sint %sDispatchSet(%sDispatchTable *table, %s value, %sHandler handler)\n{\n", S.externFn(), name, name, name, name);
+	fprintf(fp, "\tint ix = %sToIndex(value);\n", name);
+	fprintf(fp, "\tif (ix < 0) return -1;\n");
+	fprintf(fp, "\ttable->handlers[ix] = handler;\n");
+	fprintf(fp, "\treturn 0;\n");
+	fprintf(fp, "}\n");
+}
+
+//
+// Bytes per value of encode=fixed and the longest encode=varint
+//
+unsigned encodedMaxLength(const Section &section)
+{
+	unsigned count = section.entries().size();
+	
+	if (section.encoding() == ENCODE_VARINT)
+	{
+		unsigned len = 1;
+		while (len < 5 && count > (1U << (7 * len))) ++len;
+		return len;
+	}
+	
+	return count <= 0x100 ? 1 : count <= 0x10000 ? 2 : 4;
+}
+
+//
+// XxxEncode/XxxDecode: the enum index on the wire, little-endian at the
+// narrowest fixed width or as a LEB128 varint. Decode rejects indices past
+// the field count and maps back through g_XxxValueArray.
+//
+void writeEncode(FILE *fp, const struct statefields &S, const Section &section)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	unsigned width = encodedMaxLength(section);
+	
+	if (section.encoding() == ENCODE_NONE) return;
+	
+	if (section.encoding() == ENCODE_FIXED)
+	{
+		fprintf(fp, "%ssize_t %sEncode(%s value, unsigned char *out)\n{\n", S.externFn(), name, name);
+		fprintf(fp, "\tint ix = __%sIndexOf(value);\n", name);
+		fprintf(fp, "\tif (ix < 0) return 0;\n");
+		for (unsigned b = 0; b < width; ++b)
+		{
+			fprintf(fp, "\tout[%u] = (unsigned char)(ix >> %u);\n", b, b * 8);
+		}
+		fprintf(fp, "\treturn %u;\n", width);
+		fprintf(fp, "}\n");
+		
+		fprintf(fp, "%ssize_t %sDecode(const unsigned char *in, size_t len, %s *presult)\n{\n", S.externFn(), name, name);
+		fprintf(fp, "\tif (len < %u) return 0;\n", width);
+		fprintf(fp, "\tuint32_t ix = in[0]");
+		for (unsigned b = 1; b < width; ++b)
+		{
+			fprintf(fp, " | (uint32_t)in[%u] << %u", b, b * 8);
+		}
+		fprintf(fp, ";\n");
+		fprintf(fp, "\tif (ix >= %u) return 0;\n", count);
+		fprintf(fp, "\t*presult = (%s)g_%sValueArray[ix];\n", name, name);
+		fprintf(fp, "\treturn %u;\n", width);
+		fprintf(fp, "}\n");
+		
+		// fixed width batches stay branch-free: errors are collected and
+		// reported once, out of range indices read slot 0 meanwhile
+		fprintf(fp, "%ssize_t %sEncodeBatch(const %s *values, size_t count, unsigned char *out)\n{\n", S.externFn(), name, name);
+		fprintf(fp, "\tint bad = 0;\n");
+		fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+		fprintf(fp, "\t\tint ix = __%sIndexOf(values[i]);\n", name);
+		fprintf(fp, "\t\tbad |= ix;\n");
+		for (unsigned b = 0; b < width; ++b)
+		{
+			fprintf(fp, "\t\tout[i * %u + %u] = (unsigned char)(ix >> %u);\n", width, b, b * 8);
+		}
+		fprintf(fp, "\t}\n");
+		fprintf(fp, "\treturn bad < 0 ? 0 : count * %u;\n", width);
+		fprintf(fp, "}\n");
+		
+		fprintf(fp, "%ssize_t %sDecodeBatch(const unsigned char *in, size_t len, %s *out, size_t count)\n{\n", S.externFn(), name, name);
+		fprintf(fp, "\tint bad = 0;\n");
+		fprintf(fp, "\tif (len / %u < count) return 0;\n", width);
+		fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+		fprintf(fp, "\t\tuint32_t ix = in[i * %u]", width);
+		for (unsigned b = 1; b < width; ++b)
+		{
+			fprintf(fp, " | (uint32_t)in[i * %u + %u] << %u", width, b, b * 8);
+		}
+		fprintf(fp, ";\n");
+		fprintf(fp, "\t\tbad |= ix >= %u;\n", count);
+		fprintf(fp, "\t\tout[i] = (%s)g_%sValueArray[ix < %u ? ix : 0];\n", name, name, count);
+		fprintf(fp, "\t}\n");
+		fprintf(fp, "\treturn bad ? 0 : count * %u;\n", width);
+		fprintf(fp, "}\n");
+		return;
+	}
+	
+	fprintf(fp, "%ssize_t %sEncode(%s value, unsigned char *out)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tint ix = __%sIndexOf(value);\n", name);
+	fprintf(fp, "\tsize_t n = 0;\n");
+	fprintf(fp, "\tif (ix < 0) return 0;\n");
+	fprintf(fp, "\tuint32_t u = (uint32_t)ix;\n");
+	fprintf(fp, "\twhile (u >= 0x80) { out[n++] = (unsigned char)(u | 0x80); u >>= 7; }\n");
+	fprintf(fp, "\tout[n++] = (unsigned char)u;\n");
+	fprintf(fp, "\treturn n;\n");
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%ssize_t %sDecode(const unsigned char *in, size_t len, %s *presult)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tuint32_t ix = 0;\n");
+	fprintf(fp, "\tsize_t n = 0;\n");
+	fprintf(fp, "\tfor (;;)\n\t{\n");
+	fprintf(fp, "\t\tif (n == len || n == %u) return 0;\n", width);
+	fprintf(fp, "\t\tix |= (uint32_t)(in[n] & 0x7f) << (7 * n);\n");
+	fprintf(fp, "\t\tif ((in[n++] & 0x80) == 0) break;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\tif (ix >= %u) return 0;\n", count);
+	fprintf(fp, "\t*presult = (%s)g_%sValueArray[ix];\n", name, name);
+	fprintf(fp, "\treturn n;\n");
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%ssize_t %sEncodeBatch(const %s *values, size_t count, unsigned char *out)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tsize_t n = 0;\n");
+	fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+	fprintf(fp, "\t\tsize_t len = %sEncode(values[i], out + n);\n", name);
+	fprintf(fp, "\t\tif (len == 0) return 0;\n");
+	fprintf(fp, "\t\tn += len;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\treturn n;\n");
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%ssize_t %sDecodeBatch(const unsigned char *in, size_t len, %s *out, size_t count)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tsize_t n = 0;\n");
+	fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+	fprintf(fp, "\t\tsize_t used = %sDecode(in + n, len - n, &out[i]);\n", name);
+	fprintf(fp, "\t\tif (used == 0) return 0;\n");
+	fprintf(fp, "\t\tn += used;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\treturn n;\n");
+	fprintf(fp, "}\n");
+}
+
+//
+// Whole-array conversions. Offset and table lookups are written as
+// branch-free loops the compiler can vectorize; small sparse enums compare
+// each value against all fields at once with SSE2/AVX2.
+//
+void writeBatch(FILE *fp, const struct statefields &S, const Section &section, const struct indexplan &plan)
+{
+	const char *name = section.name().c_str();
+	unsigned count = section.entries().size();
+	unsigned unique = plan.firstIndex.size();
+	
+	// profile=size keeps the scalar loop: no lane tables, no vector code
+	bool simd = !S.sizeProfile && plan.resolved && plan.strategy != LOOKUP_OFFSET && plan.strategy != LOOKUP_TABLE &&
+		unique <= 16 && plan.minValue >= INT32_MIN && plan.maxValue <= INT32_MAX;
+	
+	if (simd)
+	{
+		fprintf(fp, "#if (defined(__SSE2__) || defined(__AVX2__)) && defined(__GNUC__)\n");
+		fprintf(fp, "\t#include <immintrin.h>\n");
+		fprintf(fp, "\t#define __%sBATCH_SIMD\n", name);
+		fprintf(fp, "#endif\n");
+		fprintf(fp, "#if defined(__%sBATCH_SIMD)\n", name);
+		
+		// lanes beyond the field count repeat the first value and are masked off
+		fprintf(fp, "%sint32_t g_%sBatchValues[16] __attribute__((aligned(32))) = {", S.localTable().c_str(), name);
+		for (unsigned i = 0; i < 16; ++i)
+		{
+			fprintf(fp, "%s%lld,", (i % 8) == 0 ? "\n\t" : " ", plan.values[plan.firstIndex[i < unique ? i : 0]]);
+		}
+		fprintf(fp, "\n};\n");
+		fprintf(fp, "%s%s g_%sBatchIndex[16] = {", S.localTable().c_str(), intTypeFor(0, count), name);
+		for (unsigned i = 0; i < 16; ++i)
+		{
+			fprintf(fp, "%s%u,", (i % 8) == 0 ? "\n\t" : " ", plan.firstIndex[i < unique ? i : 0]);
+		}
+		fprintf(fp, "\n};\n");
+		fprintf(fp, "#endif\n");
+	}
+	
+	fprintf(fp, "%svoid %sToIndexBatch(const %s *values, int *out, size_t count)\n{\n", S.externFn(), name, name);
+	
+	if (plan.strategy == LOOKUP_OFFSET)
+	{
+		fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+		fprintf(fp, "\t\tunsigned long long ix = (unsigned long long)((long long)values[i] - (%lldLL));\n", plan.minValue);
+		fprintf(fp, "\t\tout[i] = ix < %uULL ? (int)ix : -1;\n", count);
+		fprintf(fp, "\t}\n");
+	}
+	else if (plan.strategy == LOOKUP_TABLE)
+	{
+		unsigned long long range = (unsigned long long)(plan.maxValue - plan.minValue + 1);
+		fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+		fprintf(fp, "\t\tunsigned long long off = (unsigned long long)((long long)values[i] - (%lldLL));\n", plan.minValue);
+		fprintf(fp, "\t\toff = off < %lluULL ? off : %lluULL;\n", range, range);
+		fprintf(fp, "\t\tout[i] = g_%sIndexTable[off];\n", name);
+		fprintf(fp, "\t}\n");
+	}
+	else
+	{
+		if (simd)
+		{
+			unsigned validMask = unique >= 32 ? ~0u : (1u << unique) - 1;
+			
+			// a wider underlying type may hold inputs that only match once
+			// truncated to a lane; no field has such a value
+			std::string laneCheck = std::string("\t\tif (sizeof(") + name + ") > 4 && (long long)values[i] != (long long)(int32_t)values[i]) { out[i] = -1; continue; }\n";
+			
+			fprintf(fp, "#if defined(__%sBATCH_SIMD) && defined(__AVX2__)\n", name);
+			fprintf(fp, "\tconst __m256i t0 = _mm256_load_si256((const __m256i *)g_%sBatchValues);\n", name);
+			if (unique > 8) fprintf(fp, "\tconst __m256i t1 = _mm256_load_si256((const __m256i *)(g_%sBatchValues + 8));\n", name);
+			fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+			fprintf(fp, "%s", laneCheck.c_str());
+			fprintf(fp, "\t\t__m256i v = _mm256_set1_epi32((int32_t)values[i]);\n");
+			fprintf(fp, "\t\tunsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, t0)));\n");
+			if (unique > 8) fprintf(fp, "\t\tmask |= (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, t1))) << 8;\n");
+			fprintf(fp, "\t\tmask &= 0x%xu;\n", validMask);
+			fprintf(fp, "\t\tout[i] = mask ? (int)g_%sBatchIndex[__builtin_ctz(mask)] : -1;\n", name);
+			fprintf(fp, "\t}\n");
+			fprintf(fp, "#elif defined(__%sBATCH_SIMD)\n", name);
+			for (unsigned v = 0; v * 4 < unique; ++v)
+			{
+				fprintf(fp, "\tconst __m128i t%u = _mm_load_si128((const __m128i *)(g_%sBatchValues + %u));\n", v, name, v * 4);
+			}
+			fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+			fprintf(fp, "%s", laneCheck.c_str());
+			fprintf(fp, "\t\t__m128i v = _mm_set1_epi32((int32_t)values[i]);\n");
+			fprintf(fp, "\t\tunsigned mask = 0;\n");
+			for (unsigned v = 0; v * 4 < unique; ++v)
+			{
+				fprintf(fp, "\t\tmask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, t%u))) << %u;\n", v, v * 4);
+			}
+			fprintf(fp, "\t\tmask &= 0x%xu;\n", validMask);
+			fprintf(fp, "\t\tout[i] = mask ? (int)g_%sBatchIndex[__builtin_ctz(mask)] : -1;\n", name);
+			fprintf(fp, "\t}\n");
+			fprintf(fp, "#else\n");
+		}
+		
+		fprintf(fp, "\tfor (size_t i = 0; i < count; ++i)\n\t{\n");
+		fprintf(fp, "\t\tout[i] = __%sIndexOf(values[i]);\n", name);
+		fprintf(fp, "\t}\n");
+		
+		if (simd)
+		{
+			fprintf(fp, "#endif\n");
+		}
+	}
+	
+	fprintf(fp, "}\n");
+	
+	fprintf(fp, "%svoid %sToStringBatch(const %s *values, const char **out, size_t count)\n{\n", S.externFn(), name, name);
+	fprintf(fp, "\tint ix[64];\n");
+	fprintf(fp, "\tfor (size_t done = 0; done < count; done += 64)\n\t{\n");
+	fprintf(fp, "\t\tsize_t n = count - done < 64 ? count - done : 64;\n");
+	fprintf(fp, "\t\t%sToIndexBatch(values + done, ix, n);\n", name);
+	fprintf(fp, "\t\tfor (size_t i = 0; i < n; ++i)\n\t\t{\n");
+	fprintf(fp, "\t\t\tout[done + i] = ix[i] >= 0 ? g_%sStringPool + g_%sStringOffset[ix[i]] : NULL;\n", name, name);
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+}
+
+//
+// Thraits as a constant array of the thraits type, indexed through the
+// enum index; no heap allocation and no global constructor as long as the
+// thraits type has a constexpr constructor
+//
+void writeThraits(FILE *fp, const struct statefields &S, const Section &section, const struct indexplan &plan)
+{
+	const char *name = section.name().c_str();
+	const char *thraits = section.thraitsName().c_str();
+	unsigned count = section.entries().size();
+	
+	// slot of each enum index in the thraits array; fields sharing a value
+	// resolve to the first of them that has thraits
+	std::vector<int> slot(count, -1);
+	std::vector<unsigned> list;
+	for (unsigned i : hotOrder(section))
+	{
+		if (section.entries()[i].thraits().size() > 0)
+		{
+			slot[i] = list.size();
+			list.push_back(i);
+		}
+	}
+	
+	if (plan.resolved)
+	{
+		for (unsigned i : plan.firstIndex)
+		{
+			for (unsigned j = i; j < count && slot[i] < 0; ++j)
+			{
+				if (plan.values[j] == plan.values[i]) slot[i] = slot[j];
+			}
+		}
+	}
+	
+	fprintf(fp, "\n");
+	
+	if (list.size() > 0)
+	{
+		fprintf(fp, "%s%s g_%sThraitsArray[%u] = {\n", S.headerOnly ? "inline const " : "static const ", thraits, name, (unsigned)list.size());
+		for (unsigned i : list)
+		{
+			fprintf(fp, "\t%s%s,\n", thraits, section.entries()[i].thraits().data());
+		}
+		fprintf(fp, "};\n");
+		
+		fprintf(fp, "%s%s g_%sThraitsSlot[%u] = {", S.localTable().c_str(), intTypeFor(-1, list.size()), name, count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			fprintf(fp, "%s%d,", (i % 16) == 0 ? "\n\t" : " ", slot[i]);
+		}
+		fprintf(fp, "\n};\n");
+	}
+	
+	fprintf(fp, "%sconst %s *%s_GetThraits(%s value, const %s *defaultResult)\n{\n", S.externFn(), thraits, name, name, thraits);
+	if (list.size() > 0)
+	{
+		fprintf(fp, "\tint ix = __%sIndexOf(value);\n", name);
+		if (S.statsDefine.size() > 0) fprintf(fp, "\t__%sSTAT(%u, ix);\n", name, STAT_GETTHRAITS);
+		fprintf(fp, "\tif (ix < 0 || g_%sThraitsSlot[ix] < 0) return defaultResult;\n", name);
+		fprintf(fp, "\treturn &g_%sThraitsArray[g_%sThraitsSlot[ix]];\n", name, name);
+	}
+	else
+	{
+		if (S.statsDefine.size() > 0) fprintf(fp, "\t__%sSTAT(%u, __%sIndexOf(value));\n", name, STAT_GETTHRAITS, name);
+		fprintf(fp, "\t(void)value;\n");
+		fprintf(fp, "\treturn defaultResult;\n");
+	}
+	fprintf(fp, "}\n");
+}
+
+//
+// Self-contained benchmark: includes the generated source (so the
+// stringify and thraits macros apply to it) and times each conversion
+// over uniform and Zipf-distributed fields. Valid C99 and C++.
+//
+void writeBench(FILE *fp, const struct statefields &S, const std::string &sourceFileName)
+{
+	fprintf(fp, "%s\n", S.introComment.c_str());
+	fprintf(fp, "// benchmark; usage: <program> [rounds]\n");
+	fprintf(fp, "#if !defined(_POSIX_C_SOURCE)\n");
+	fprintf(fp, "\t#define _POSIX_C_SOURCE 199309L\n");
+	fprintf(fp, "#endif\n");
+	if (S.stringifyDefine.size() > 0)
+	{
+		fprintf(fp, "#if !defined(%s)\n", S.stringifyDefine.c_str());
+		fprintf(fp, "\t#define %s\n", S.stringifyDefine.c_str());
+		fprintf(fp, "#endif\n");
+	}
+	for (auto &section : S.sections)
+	{
+		if (section.thraitsName().size() > 0 && section.thraitsEnableMacro().size() > 0)
+		{
+			fprintf(fp, "#if !defined(%s)\n", section.thraitsEnableMacro().c_str());
+			fprintf(fp, "\t#define %s\n", section.thraitsEnableMacro().c_str());
+			fprintf(fp, "#endif\n");
+		}
+	}
+	fprintf(fp, "#include <stdio.h>\n");
+	fprintf(fp, "#include <stdlib.h>\n");
+	fprintf(fp, "#include <time.h>\n");
+	fprintf(fp, "#include \"%s\"\n", sourceFileName.c_str());
+	fprintf(fp, "\n");
+	fprintf(fp, "#define BENCH_N 4096\n");
+	fprintf(fp, "static unsigned g_benchRounds = 1000;\n");
+	fprintf(fp, "static volatile unsigned long long g_benchSink;\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "static double benchNow(void)\n{\n");
+	fprintf(fp, "\tstruct timespec ts;\n");
+	fprintf(fp, "\tclock_gettime(CLOCK_MONOTONIC, &ts);\n");
+	fprintf(fp, "\treturn (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "// BENCH_N field indices; skewed picks rank r with weight 1/(r+1),\n");
+	fprintf(fp, "// ranks follow the field weights (declaration order without weights)\n");
+	fprintf(fp, "//\n");
+	fprintf(fp, "static void benchPick(unsigned *out, const unsigned *byRank, unsigned count, int skewed)\n{\n");
+	fprintf(fp, "\tunsigned long long state = 0x853c49e6748fea9bULL;\n");
+	fprintf(fp, "\tdouble total = 0;\n");
+	fprintf(fp, "\tunsigned i, r;\n");
+	fprintf(fp, "\tfor (r = 0; r < count; ++r) total += 1.0 / (r + 1);\n");
+	fprintf(fp, "\tfor (i = 0; i < BENCH_N; ++i)\n\t{\n");
+	fprintf(fp, "\t\tstate = state * 6364136223846793005ULL + 1442695040888963407ULL;\n");
+	fprintf(fp, "\t\tdouble u = (double)(state >> 11) / 9007199254740992.0;\n");
+	fprintf(fp, "\t\tif (!skewed)\n\t\t{\n");
+	fprintf(fp, "\t\t\tout[i] = byRank[(unsigned)(u * count)];\n");
+	fprintf(fp, "\t\t\tcontinue;\n");
+	fprintf(fp, "\t\t}\n");
+	fprintf(fp, "\t\tu *= total;\n");
+	fprintf(fp, "\t\tfor (r = 0; r + 1 < count && u >= 1.0 / (r + 1); ++r) u -= 1.0 / (r + 1);\n");
+	fprintf(fp, "\t\tout[i] = byRank[r];\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "static void benchReport(const char *enumName, const char *op, const char *dist, double ns, unsigned long long sum)\n{\n");
+	fprintf(fp, "\tdouble perOp = ns / ((double)g_benchRounds * BENCH_N);\n");
+	fprintf(fp, "\tg_benchSink += sum;\n");
+	fprintf(fp, "\tprintf(\"%%-20s %%-22s %%-8s %%9.2f ns/op %%10.1f Mops/s\\n\", enumName, op, dist, perOp, 1e3 / perOp);\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "#define BENCH_LOOP(enumName, op, dist, body) \\\n");
+	fprintf(fp, "\tdo { \\\n");
+	fprintf(fp, "\t\tunsigned long long sum = 0; \\\n");
+	fprintf(fp, "\t\tunsigned r, i; \\\n");
+	fprintf(fp, "\t\tdouble t0 = benchNow(); \\\n");
+	fprintf(fp, "\t\tfor (r = 0; r < g_benchRounds; ++r) \\\n");
+	fprintf(fp, "\t\t\tfor (i = 0; i < BENCH_N; ++i) { body; } \\\n");
+	fprintf(fp, "\t\tbenchReport(enumName, op, dist, benchNow() - t0, sum); \\\n");
+	fprintf(fp, "\t} while (0)\n");
+	
+	for (auto &section : S.sections)
+	{
+		const char *name = section.name().c_str();
+		unsigned count = section.entries().size();
+		
+		if (count == 0) continue;
+		
+		// prefix stripped lookups skip the common prefix, the suffix hash path
+		size_t prefixLen = commonPrefix(section).size();
+		
+		fprintf(fp, "\n");
+		fprintf(fp, "static void bench%s(void)\n{\n", name);
+		fprintf(fp, "\tstatic const char *const names[%u] = {", count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			fprintf(fp, "%s\"%s\",", (i % 4) == 0 ? "\n\t\t" : " ", section.entries()[i].name().data());
+		}
+		fprintf(fp, "\n\t};\n");
+		fprintf(fp, "\tstatic const char *const foldedNames[%u] = {", count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			fprintf(fp, "%s\"%s\",", (i % 4) == 0 ? "\n\t\t" : " ", asciiFold(section.entries()[i].name()).c_str());
+		}
+		fprintf(fp, "\n\t};\n");
+		fprintf(fp, "\tstatic const unsigned byRank[%u] = {", count);
+		std::vector<unsigned> order = hotOrder(section);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			fprintf(fp, "%s%u,", (i % 16) == 0 ? "\n\t\t" : " ", order[i]);
+		}
+		fprintf(fp, "\n\t};\n");
+		fprintf(fp, "\tstatic unsigned ix[BENCH_N];\n");
+		fprintf(fp, "\tstatic %s values[BENCH_N];\n", name);
+		fprintf(fp, "\t%s v = %sFromIndex(0);\n", name, name);
+		fprintf(fp, "\tint skewed;\n");
+		fprintf(fp, "\tunsigned i;\n");
+		fprintf(fp, "\tfor (skewed = 0; skewed < 2; ++skewed)\n\t{\n");
+		fprintf(fp, "\t\tconst char *dist = skewed ? \"skewed\" : \"uniform\";\n");
+		fprintf(fp, "\t\tbenchPick(ix, byRank, %u, skewed);\n", count);
+		fprintf(fp, "\t\tfor (i = 0; i < BENCH_N; ++i) values[i] = %sFromIndex(ix[i]);\n", name);
+		fprintf(fp, "\t\tBENCH_LOOP(\"%s\", \"ToString\", dist, sum += (size_t)%sToString(values[i]));\n", name, name);
+		fprintf(fp, "\t\tBENCH_LOOP(\"%s\", \"ToIndex\", dist, sum += (unsigned)%sToIndex(values[i]));\n", name, name);
+		fprintf(fp, "\t\tBENCH_LOOP(\"%s\", \"FromString\", dist, sum += (unsigned)%sFromString(names[ix[i]], &v, false, 0); sum += (unsigned)v);\n", name, name);
+		fprintf(fp, "\t\tBENCH_LOOP(\"%s\", \"FromString ignoreCase\", dist, sum += (unsigned)%sFromString(foldedNames[ix[i]], &v, true, 0); sum += (unsigned)v);\n", name, name);
+		if (prefixLen > 0)
+		{
+			fprintf(fp, "\t\tBENCH_LOOP(\"%s\", \"FromString prefix %u\", dist, sum += (unsigned)%sFromString(names[ix[i]] + %u, &v, false, %u); sum += (unsigned)v);\n", name, (unsigned)prefixLen, name, (unsigned)prefixLen, (unsigned)prefixLen);
+		}
+		if (section.thraitsName().size() > 0)
+		{
+			fprintf(fp, "#if defined(__cplusplus)\n");
+			fprintf(fp, "\t\tBENCH_LOOP(\"%s\", \"_GetThraits\", dist, sum += (size_t)%s_GetThraits(values[i], NULL));\n", name, name);
+			fprintf(fp, "#endif\n");
+		}
+		fprintf(fp, "\t}\n");
+		fprintf(fp, "}\n");
+	}
+	
+	fprintf(fp, "\n");
+	fprintf(fp, "int main(int argc, char **argv)\n{\n");
+	fprintf(fp, "\tif (argc > 1) g_benchRounds = (unsigned)atoi(argv[1]);\n");
+	fprintf(fp, "\tif (g_benchRounds == 0) g_benchRounds = 1;\n");
+	for (auto &section : S.sections)
+	{
+		if (section.entries().size() > 0) fprintf(fp, "\tbench%s();\n", section.name().c_str());
+	}
+	fprintf(fp, "\treturn 0;\n");
+	fprintf(fp, "}\n");
+}
+
+void makeEnumFiles(struct statefields &S)
+{
+	std::string title;
+	extractFileTitle(S.fileName, title);
+	
+	unsigned titleBufSize = title.size();
+	char titleBuf[titleBufSize +1];
+	memset(titleBuf, 0, titleBufSize +1);
+	for (unsigned i = 0, titleBufPos = 0; i < titleBufSize; ++i)
+	{
+		char ch = title[i];
+		if (isalnum(ch) || ch == '_')
+		{
+			titleBuf[titleBufPos++] = ch;
+		}
+	}
+	
+	if (S.headerGuard.empty())
+	{
+		S.headerGuard = titleBuf;
+		
+		// derived from the enum names so reruns and parallel runs agree
+		std::string guardText = title;
+		for (auto &section : S.sections)
+		{
+			guardText += "\n" + section.name();
+			for (auto &entry : section.entries())
+			{
+				guardText += " ";
+				guardText += entry.name();
+			}
+		}
+		uint64_t h = phHash(guardText.data(), guardText.size(), 14695981039346656037ULL);
+		
+		unsigned rndLen = 16;
+		char rndBuf[rndLen +1];
+		memset(rndBuf, 0, rndLen +1);
+		for (unsigned i = 0; i < rndLen; ++i)
+		{
+			if (i == rndLen / 2) h = phHash(guardText.data(), guardText.size(), h);
+			rndBuf[i] = ('a' + (h % ('z'-'a')));
+			h /= ('z'-'a');
+		}
+		
+		S.headerGuard += std::string("_") + std::string(rndBuf);
+	}
+	
+	std::string cHeaderFileName = title + "." + S.cHeader;
+	
+	std::string final_cHeaderActualFileName = S.includeDir + cHeaderFileName;
+	std::string final_cSourceFileName = S.srcDir + title + "." + S.cSource;
+	
+	std::string oldHGMacroName = tryReadOldHeaderGuardMacroName(final_cHeaderActualFileName);
 	if (oldHGMacroName.size() > 0) {
 		S.headerGuard = oldHGMacroName;
 	}
 	
-	FILE *cHeaderFP = fopen(cHeaderActualFileName.c_str(), "w");
-	FILE *cSourceFP = fopen(cSourceFileName.c_str(), "w");
+	// both files are built in memory and only written if they changed
+	char *cHeaderBuf = nullptr, *cSourceBuf = nullptr;
+	size_t cHeaderLen = 0, cSourceLen = 0;
+	FILE *cHeaderFP = open_memstream(&cHeaderBuf, &cHeaderLen);
+	FILE *cSourceFP = open_memstream(&cSourceBuf, &cSourceLen);
+	
+	fprintf(cHeaderFP, "%s%s\n", HEADER_GUARD_START_TOKEN, S.headerGuard.c_str());
+	
+	fprintf(cHeaderFP, "%s\n", S.introComment.c_str());
+	fprintf(cSourceFP, "%s\n", S.introComment.c_str());
+	
+	fprintf(cHeaderFP, "#ifndef __enumg_HeaderGuard_%s_INCLUDED__\n", S.headerGuard.c_str());
+	fprintf(cHeaderFP, "#define __enumg_HeaderGuard_%s_INCLUDED__\n", S.headerGuard.c_str());
+	
+	fprintf(cSourceFP, "#include \"%s\"\n", cHeaderFileName.c_str());
+	
+	fprintf(cHeaderFP, "#include <stddef.h>\n");
+	fprintf(cHeaderFP, "#if !defined(__cplusplus)\n");
+	fprintf(cHeaderFP, "\t#include <stdbool.h>\n");
+	fprintf(cHeaderFP, "#endif\n");
+	fprintf(cHeaderFP, "#if !defined(ENUMG_DEFAULT_ARG)\n");
+	fprintf(cHeaderFP, "\t#if defined(__cplusplus)\n");
+	fprintf(cHeaderFP, "\t\t#define ENUMG_DEFAULT_ARG(x) = x\n");
+	fprintf(cHeaderFP, "\t#else\n");
+	fprintf(cHeaderFP, "\t\t#define ENUMG_DEFAULT_ARG(x)\n");
+	fprintf(cHeaderFP, "\t#endif\n");
+	fprintf(cHeaderFP, "#endif\n");
+	fprintf(cHeaderFP, "#if defined(__cplusplus) && __cplusplus >= 201703L\n");
+	fprintf(cHeaderFP, "\t#include <string_view>\n");
+	fprintf(cHeaderFP, "#endif\n");
+	
+	for (auto &section : S.sections)
+	{
+		if (section.containers())
+		{
+			fprintf(cHeaderFP, "#if defined(__cplusplus)\n");
+			fprintf(cHeaderFP, "\t#include <cstdint>\n");
+			fprintf(cHeaderFP, "\t#include <initializer_list>\n");
+			fprintf(cHeaderFP, "#endif\n");
+			// C++11 constexpr allows a single return statement only
+			fprintf(cHeaderFP, "#if !defined(ENUMG_CONSTEXPR14)\n");
+			fprintf(cHeaderFP, "\t#if defined(__cplusplus) && __cplusplus >= 201402L\n");
+			fprintf(cHeaderFP, "\t\t#define ENUMG_CONSTEXPR14 constexpr\n");
+			fprintf(cHeaderFP, "\t#else\n");
+			fprintf(cHeaderFP, "\t\t#define ENUMG_CONSTEXPR14\n");
+			fprintf(cHeaderFP, "\t#endif\n");
+			fprintf(cHeaderFP, "#endif\n");
+			break;
+		}
+	}
+	
+	if (S.statsDefine.size() > 0)
+	{
+		fprintf(cHeaderFP, "#if defined(%s)\n", S.statsDefine.c_str());
+		fprintf(cHeaderFP, "\t#include <stdio.h>\n");
+		fprintf(cHeaderFP, "#endif\n");
+	}
+	
+	for (auto &section : S.sections)
+	{
+		if (section.dispatch())
+		{
+			fprintf(cHeaderFP, "#if defined(__cplusplus)\n");
+			fprintf(cHeaderFP, "\t#include <type_traits>\n");
+			fprintf(cHeaderFP, "#endif\n");
+			break;
+		}
+	}
+	
+	for (auto line : S.topExprs)
+	{
+		fprintf(cHeaderFP, "%s\n", line.c_str());
+	}
+	
+	for (auto line : S.includeFiles)
+	{
+		fprintf(cHeaderFP, "#include %s\n", line.c_str());
+	}
+	
+	// definitions go to the source, or to the header in header-only mode
+	FILE *cDefFP = S.headerOnly ? cHeaderFP : cSourceFP;
+	
+	if (S.headerOnly)
+	{
+		fprintf(cHeaderFP, "#if !defined(__cplusplus) || __cplusplus < 201703L\n");
+		fprintf(cHeaderFP, "\t#error \"%s\" is generated header-only and requires C++17\n", cHeaderFileName.c_str());
+		fprintf(cHeaderFP, "#endif\n");
+	}
+	
+	fprintf(cDefFP, "#if defined(__cplusplus)\n");
+	fprintf(cDefFP, "\t#include <cstring>\n");
+	fprintf(cDefFP, "\t#include <cctype>\n");
+	fprintf(cDefFP, "\t#include <cstdint>\n");
+	fprintf(cDefFP, "#else\n");
+	fprintf(cDefFP, "\t#include <string.h>\n");
+	fprintf(cDefFP, "\t#include <ctype.h>\n");
+	fprintf(cDefFP, "\t#include <stdint.h>\n");
+	fprintf(cDefFP, "#endif\n");
+	
+	if (S.statsDefine.size() > 0)
+	{
+		fprintf(cDefFP, "#if defined(%s) && !defined(ENUMG_STAT_ADD)\n", S.statsDefine.c_str());
+		fprintf(cDefFP, "\t#if defined(__GNUC__)\n");
+		fprintf(cDefFP, "\t\t#define ENUMG_STAT_ADD(c) __atomic_fetch_add(&(c), 1, __ATOMIC_RELAXED)\n");
+		fprintf(cDefFP, "\t\t#define ENUMG_STAT_LOAD(c) __atomic_load_n(&(c), __ATOMIC_RELAXED)\n");
+		fprintf(cDefFP, "\t#else\n");
+		fprintf(cDefFP, "\t\t#define ENUMG_STAT_ADD(c) ((void)++(c))\n");
+		fprintf(cDefFP, "\t\t#define ENUMG_STAT_LOAD(c) (c)\n");
+		fprintf(cDefFP, "\t#endif\n");
+		fprintf(cDefFP, "\t// one counter per cache line\n");
+		fprintf(cDefFP, "\ttypedef struct enumg_stat_counter { uint64_t n; char pad[56]; } enumg_stat_counter;\n");
+		fprintf(cDefFP, "#endif\n");
+	}
+	
+	
+	
+	
+	for (auto section : S.sections)
+	{
+		logf("write enum %s\n", section.name().c_str());
+		
+		struct indexplan plan;
+		planIndexLookup(S, section, plan);
+		validateFlags(section, plan);
+		fprintf(cHeaderFP, "%s %s\n{\n", section.type().c_str(), section.name().c_str());
+		
+		for (auto entry : section.entries())
+		{
+			// fill out header enum decl
+			fprintf(cHeaderFP, "\t%s,\n", entry.fullText().data());
+		}
+		
+		fprintf(cHeaderFP, "};\n");
+		
+		if (section.type() == "enum")
+		{
+			// C has no implicit type name for enums
+			fprintf(cHeaderFP, "#if !defined(__cplusplus)\n");
+			fprintf(cHeaderFP, "typedef enum %s %s;\n", section.name().c_str(), section.name().c_str());
+			fprintf(cHeaderFP, "#endif\n");
+		}
+		
+		writeFlagsOperators(cHeaderFP, section, plan);
+		
+		if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
+		fprintf(cHeaderFP, "%sconst char *%sToString(%s value);\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "%sconst char *%sToStringN(%s value, size_t *plen);\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "#if defined(__cplusplus)\n");
+		fprintf(cHeaderFP, "%s %sFromString(const char *str);\n", section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "#endif\n");
+		fprintf(cHeaderFP, "%sunsigned %sValueCount();\n", S.constexprFn(), section.name().c_str());
+		fprintf(cHeaderFP, "%s%s %sFromIndex(unsigned index);\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "%sint %sFromString(const char *str, %s *presult, bool ignoreCase ENUMG_DEFAULT_ARG(false), int ignorePrefixLen ENUMG_DEFAULT_ARG(0));\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "%sint %sFromStringN(const char *str, size_t len, %s *presult, bool ignoreCase ENUMG_DEFAULT_ARG(false), int ignorePrefixLen ENUMG_DEFAULT_ARG(0));\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		
+		size_t minNameLen, maxNameLen;
+		nameLengthRange(section, minNameLen, maxNameLen);
+		fprintf(cHeaderFP, "enum { %sMinNameLength = %u, %sMaxNameLength = %u };\n", section.name().c_str(), (unsigned)minNameLen, section.name().c_str(), (unsigned)maxNameLen);
+		fprintf(cHeaderFP, "enum { %sPrefixLength = %u }; // \"%s\"\n", section.name().c_str(), (unsigned)commonPrefix(section).size(), commonPrefix(section).c_str());
+		fprintf(cHeaderFP, "%sint %sFromStringAny(const char *str, %s *presult, bool ignoreCase ENUMG_DEFAULT_ARG(false));\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "%sint %sFromStringAnyN(const char *str, size_t len, %s *presult, bool ignoreCase ENUMG_DEFAULT_ARG(false));\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		
+		// "Name(-0x" + 16 digits + ")"
+		unsigned toCharsMaxLen = std::max((unsigned)maxNameLen, (unsigned)section.name().size() + 21);
+		fprintf(cHeaderFP, "enum { %sToCharsMaxLength = %u };\n", section.name().c_str(), toCharsMaxLen);
+		fprintf(cHeaderFP, "%schar *%sToChars(char *first, char *last, %s value);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		
+		fprintf(cHeaderFP, "#if defined(__cplusplus) && __cplusplus >= 201703L\n");
+		fprintf(cHeaderFP, "inline int %sFromString(std::string_view str, %s *presult, bool ignoreCase = false, int ignorePrefixLen = 0)\n{\n", section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "\treturn %sFromStringN(str.data(), str.size(), presult, ignoreCase, ignorePrefixLen);\n", section.name().c_str());
+		fprintf(cHeaderFP, "}\n");
+		fprintf(cHeaderFP, "inline int %sFromStringAny(std::string_view str, %s *presult, bool ignoreCase = false)\n{\n", section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "\treturn %sFromStringAnyN(str.data(), str.size(), presult, ignoreCase);\n", section.name().c_str());
+		fprintf(cHeaderFP, "}\n");
+		fprintf(cHeaderFP, "#endif\n");
+		fprintf(cHeaderFP, "%sint %sToIndex(%s value);\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "%svoid %sToIndexBatch(const %s *values, int *out, size_t count);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cHeaderFP, "%svoid %sToStringBatch(const %s *values, const char **out, size_t count);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		if (section.flags())
+		{
+			fprintf(cHeaderFP, "enum { %sFlagsToCharsMaxLength = %u };\n", section.name().c_str(), flagsToCharsMaxLength(section, plan));
+			fprintf(cHeaderFP, "%schar *%sFlagsToChars(char *first, char *last, %s value);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+			fprintf(cHeaderFP, "%sint %sFlagsFromString(const char *str, %s *presult, bool ignoreCase ENUMG_DEFAULT_ARG(false));\n", S.externFn(), section.name().c_str(), section.name().c_str());
+			fprintf(cHeaderFP, "%sint %sFlagsFromStringN(const char *str, size_t len, %s *presult, bool ignoreCase ENUMG_DEFAULT_ARG(false));\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		}
+		writeFormatters(cHeaderFP, section);
+		if (section.encoding() != ENCODE_NONE)
+		{
+			fprintf(cHeaderFP, "enum { %sEncodedMaxLength = %u };\n", section.name().c_str(), encodedMaxLength(section));
+			fprintf(cHeaderFP, "%ssize_t %sEncode(%s value, unsigned char *out);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+			fprintf(cHeaderFP, "%ssize_t %sDecode(const unsigned char *in, size_t len, %s *presult);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+			fprintf(cHeaderFP, "%ssize_t %sEncodeBatch(const %s *values, size_t count, unsigned char *out);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+			fprintf(cHeaderFP, "%ssize_t %sDecodeBatch(const unsigned char *in, size_t len, %s *out, size_t count);\n", S.externFn(), section.name().c_str(), section.name().c_str());
+		}
+		if (S.statsDefine.size() > 0)
+		{
+			fprintf(cHeaderFP, "#if defined(%s)\n", S.statsDefine.c_str());
+			fprintf(cHeaderFP, "%svoid %sDumpStats(FILE *fp);\n", S.externFn(), section.name().c_str());
+			fprintf(cHeaderFP, "%svoid %sResetStats(void);\n", S.externFn(), section.name().c_str());
+			fprintf(cHeaderFP, "#endif\n");
+		}
+		writeContainers(cHeaderFP, S, section, plan);
+		writeDispatchDecl(cHeaderFP, S, section);
+		if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#endif\n");
+		
+		if (section.thraitsName().size() > 0)
+		{
+			if (section.thraitsEnableMacro().size() > 0) {
+				fprintf(cHeaderFP, "#if defined(%s)\n", section.thraitsEnableMacro().c_str());
+			}
+			
+			fprintf(cHeaderFP, "%sconst %s *%s_GetThraits(%s value, const %s *defaultResult = nullptr);\n", S.externFn(), section.thraitsName().c_str(), section.name().c_str(), section.name().c_str(), section.thraitsName().c_str());
+			
+			if (section.thraitsEnableMacro().size() > 0) {
+				fprintf(cHeaderFP, "#endif // %s\n", section.thraitsEnableMacro().c_str());
+			}
+		}
+		
+		//
+		// value -> index mapping; needed by the stringify functions and thraits
+		//
+		std::string coreCondition;
+		bool hasThraits = section.thraitsName().size() > 0;
+		if (S.stringifyDefine.size() > 0 && !hasThraits)
+		{
+			coreCondition = "defined(" + S.stringifyDefine + ")";
+		}
+		else if (S.stringifyDefine.size() > 0 && section.thraitsEnableMacro().size() > 0)
+		{
+			coreCondition = "defined(" + S.stringifyDefine + ") || defined(" + section.thraitsEnableMacro() + ")";
+		}
+		
+		if (coreCondition.size() > 0) fprintf(cDefFP, "#if %s\n", coreCondition.c_str());
+		writeIndexCore(cDefFP, S, section, plan);
+		writeStatsCore(cDefFP, S, section);
+		if (coreCondition.size() > 0) fprintf(cDefFP, "#endif\n");
+		
+		if (S.stringifyDefine.size() > 0) fprintf(cDefFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
+		
+		//
+		// enum field name string array
+		//
+		writeStringPool(cDefFP, S, section, "", false);
+		writeStringPoolIndex(cDefFP, S, section);
+		
+		//
+		// to c-string
+		//
+		fprintf(cDefFP, "%sconst char *%sToString(%s value)\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cDefFP, "{\n");
+		fprintf(cDefFP, "\tint ix = __%sIndexOf(value);\n", section.name().c_str());
+		if (S.statsDefine.size() > 0) fprintf(cDefFP, "\t__%sSTAT(%u, ix);\n", section.name().c_str(), STAT_TOSTRING);
+		fprintf(cDefFP, "\tif (ix >= 0) {\n");
+		fprintf(cDefFP, "\t\treturn g_%sStringPool + g_%sStringOffset[ix];\n", section.name().c_str(), section.name().c_str());
+		fprintf(cDefFP, "\t} else {\n");
+		fprintf(cDefFP, "\t\treturn NULL;\n");
+		fprintf(cDefFP, "\t}\n");
+		fprintf(cDefFP, "}\n");
+		
+		//
+		// to c-string and length
+		//
+		fprintf(cDefFP, "%sconst char *%sToStringN(%s value, size_t *plen)\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cDefFP, "{\n");
+		fprintf(cDefFP, "\tint ix = __%sIndexOf(value);\n", section.name().c_str());
+		if (S.statsDefine.size() > 0) fprintf(cDefFP, "\t__%sSTAT(%u, ix);\n", section.name().c_str(), STAT_TOSTRING);
+		fprintf(cDefFP, "\tif (ix >= 0) {\n");
+		fprintf(cDefFP, "\t\t*plen = g_%sStringLength[ix];\n", section.name().c_str());
+		fprintf(cDefFP, "\t\treturn g_%sStringPool + g_%sStringOffset[ix];\n", section.name().c_str(), section.name().c_str());
+		fprintf(cDefFP, "\t} else {\n");
+		fprintf(cDefFP, "\t\t*plen = 0;\n");
+		fprintf(cDefFP, "\t\treturn NULL;\n");
+		fprintf(cDefFP, "\t}\n");
+		fprintf(cDefFP, "}\n");
+		
+		
+		
+		
+		if (S.stringifyDefine.size() > 0) fprintf(cDefFP, "#endif\n");
+		
+//		if (!S.cppStringifyDisable)
+//		{
+//			if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#if defined(%s) && defined(__cplusplus)\n", S.stringifyDefine.c_str());
+//			fprintf(cHeaderFP, "void %sToCppString(std::string &out, %s value);\n", section.name().c_str(), section.name().c_str());
+//			if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#endif\n");
+//
+//
+//			if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#if defined(%s) && defined(__cplusplus)\n", S.stringifyDefine.c_str());
+//			fprintf(cSourceFP, "void %sToCppString(std::string &out, %s value)\n{\n", section.name().c_str(), section.name().c_str());
+//			fprintf(cSourceFP, "\tout = %sToString(value);\n", section.name().c_str());
+//			fprintf(cSourceFP, "}\n");
+//			if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#endif\n");
+//		}
+		
+		if (S.stringifyDefine.size() > 0) fprintf(cDefFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
+		//
+		// from index
+		//
+		fprintf(cDefFP, "%s%s %sFromIndex(unsigned index)\n{\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		fprintf(cDefFP, "\treturn (%s)g_%sValueArray[index];\n", section.name().c_str(), section.name().c_str());
+		fprintf(cDefFP, "}\n");
+		fprintf(cDefFP, "%sunsigned %sValueCount()\n{\n", S.constexprFn(), section.name().c_str());
+		fprintf(cDefFP, "\treturn %u;\n", (unsigned)section.entries().size());
+		fprintf(cDefFP, "}\n");
+		
+		//
+		// from string 
+		//
+		writeFromString(cDefFP, S, section);
+		
+		//
+		// To Index
+		//
+		fprintf(cDefFP, "%sint %sToIndex(%s value)\n{\n", S.constexprFn(), section.name().c_str(), section.name().c_str());
+		if (S.statsDefine.size() > 0)
+		{
+			fprintf(cDefFP, "\tint ix = __%sIndexOf(value);\n", section.name().c_str());
+			fprintf(cDefFP, "\t__%sSTAT(%u, ix);\n", section.name().c_str(), STAT_TOINDEX);
+			fprintf(cDefFP, "\treturn ix;\n");
+		}
+		else
+		{
+			fprintf(cDefFP, "\treturn __%sIndexOf(value);\n", section.name().c_str());
+		}
+		fprintf(cDefFP, "}\n");
+		
+		//
+		// to caller buffer
+		//
+		writeToChars(cDefFP, S, section);
+		
+		//
+		// batch conversion
+		//
+		writeBatch(cDefFP, S, section, plan);
+		
+		//
+		// flags to and from "A|B|C"
+		//
+		writeFlagsStrings(cDefFP, S, section, plan);
+		
+		//
+		// handler table
+		//
+		writeDispatchDef(cDefFP, S, section);
+		
+		//
+		// instrumentation report
+		//
+		writeDumpStats(cDefFP, S, section);
+		
+		//
+		// wire encoding
+		//
+		writeEncode(cDefFP, S, section);
+		
+		if (S.stringifyDefine.size() > 0) fprintf(cDefFP, "#endif\n");
+		
+		
+		
+		//
+		// thraits
+		//
+		if (section.thraitsName().size() > 0) 
+		{
+			if (section.thraitsEnableMacro().size() > 0) {
+				fprintf(cDefFP, "#if defined(%s)\n", section.thraitsEnableMacro().c_str());
+			}
+			
+			writeThraits(cDefFP, S, section, plan);
+			
+			if (section.thraitsEnableMacro().size() > 0) {
+				fprintf(cDefFP, "#endif // %s\n", section.thraitsEnableMacro().c_str());
+			}
+		}
+		
+		
+	}
+	
+	for (auto line : S.bottomExprs)
+	{
+		fprintf(cHeaderFP, "%s\n", line.c_str());
+	}
+	
+	fprintf(cHeaderFP, "#endif // (header guard)\n");
+	fclose(cHeaderFP);
+	fclose(cSourceFP);
+	
+	writeIfChanged(final_cHeaderActualFileName, cHeaderBuf, cHeaderLen);
+	writeIfChanged(final_cSourceFileName, cSourceBuf, cSourceLen);
+	
+	free(cHeaderBuf);
+	free(cSourceBuf);
+	
+	S.outputFiles.push_back(final_cHeaderActualFileName);
+	S.outputFiles.push_back(final_cSourceFileName);
+	
+	if (S.emitBench)
+	{
+		std::string final_benchFileName = S.srcDir + title + "_bench." + S.cSource;
+		
+		// the benchmark sits next to the source and includes it by name
+		std::string sourceName = title.substr(title.find_last_of('/') + 1) + "." + S.cSource;
+		
+		char *benchBuf = nullptr;
+		size_t benchLen = 0;
+		FILE *benchFP = open_memstream(&benchBuf, &benchLen);
+		writeBench(benchFP, S, sourceName);
+		fclose(benchFP);
+		
+		writeIfChanged(final_benchFileName, benchBuf, benchLen);
+		free(benchBuf);
+		S.outputFiles.push_back(final_benchFileName);
+	}
+}
+
+//
+// --manifest: per input file a key (enumg version and options) and the
+// hash of every file it read or wrote. When all of them still match, the
+// input is neither parsed nor generated again.
+//
+struct manifestentry
+{
+	std::string key;
+	std::vector<std::pair<std::string, std::string>> inputs;
+	std::vector<std::pair<std::string, std::string>> outputs;
+	bool recorded = false;	// written by this run, wins over the file
+};
+
+struct manifest
+{
+	std::string fileName;
+	std::map<std::string, manifestentry> entries;
+	std::mutex mutex;
+	bool changed = false;
+};
+
+std::string hashHex(uint64_t h)
+{
+	char buf[17];
+	snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+	return buf;
+}
+
+// "-" if the file can not be read
+std::string fileHash(const std::string &fileName)
+{
+	FILE *fp = fopen(fileName.c_str(), "rb");
+	if (!fp) return "-";
+	
+	uint64_t h = 14695981039346656037ULL;
+	char buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+	{
+		h = phHash(buf, n, h);
+	}
+	fclose(fp);
+	
+	return hashHex(h);
+}
+
+std::string manifestKey(const struct options &opts, const std::string &introComment)
+{
+	std::string text = std::string(ENUMG_VERSION) + "\n" + introComment;
+	text += opts.emitBench ? "bench\n" : "\n";
+	text += opts.tune ? "tune\n" : "\n";
+	return hashHex(phHash(text.data(), text.size(), 14695981039346656037ULL));
+}
+
+//
+// "<hash> <file>" after the line tag; the hash is 16 hex digits or "-"
+//
+bool manifestField(const char *text, std::string &hash, std::string &name)
+{
+	const char *space = strchr(text, ' ');
+	if (!space || space[1] == 0) return false;
+	
+	hash.assign(text, space - text);
+	if (hash != "-" && (hash.size() != 16 || strspn(hash.c_str(), "0123456789abcdef") != 16)) return false;
+	
+	name = space + 1;
+	return true;
+}
+
+//
+// Format: "input <key> <file>" followed by "file <hash> <file>" lines for
+// files read and "output <hash> <file>" lines for files written. A
+// malformed line drops the entry it belongs to, so that input is stale.
+//
+void loadManifest(struct manifest &M)
+{
+	FILE *fp = fopen(M.fileName.c_str(), "r");
+	if (!fp) return;
+	
+	char line[4096];
+	std::string input, hash, name;
+	manifestentry *entry = nullptr;
+	bool skip = false;
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (!strchr(line, '\n') && !feof(fp))
+		{
+			// longer than the buffer: the rest would read as its own line
+			int ch;
+			while ((ch = fgetc(fp)) != EOF && ch != '\n') {}
+			if (entry) M.entries.erase(input);
+			entry = nullptr;
+			skip = true;
+			continue;
+		}
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] == 0 || line[0] == '#') continue;
+		
+		bool ok = false;
+		if (strncmp(line, "input ", 6) == 0)
+		{
+			entry = nullptr;
+			skip = false;
+			if (manifestField(line + 6, hash, name) && hash != "-")
+			{
+				input = name;
+				entry = &M.entries[input];
+				*entry = manifestentry();
+				entry->key = hash;
+				continue;
+			}
+		}
+		else if (skip)
+		{
+			continue;
+		}
+		else if (strncmp(line, "file ", 5) == 0)
+		{
+			ok = entry && manifestField(line + 5, hash, name);
+			if (ok) entry->inputs.push_back(std::make_pair(name, hash));
+		}
+		else if (strncmp(line, "output ", 7) == 0)
+		{
+			ok = entry && manifestField(line + 7, hash, name);
+			if (ok) entry->outputs.push_back(std::make_pair(name, hash));
+		}
+		
+		if (!ok)
+		{
+			if (entry) M.entries.erase(input);
+			entry = nullptr;
+			skip = true;
+		}
+	}
+	
+	fclose(fp);
+}
+
+//
+// Several enumg processes may share one manifest, e.g. one per ini in a
+// Ninja build. The file is locked while the entries on disk are re-read
+// and merged with the ones recorded by this run, then replaced.
+//
+void saveManifest(struct manifest &M)
+{
+	if (!M.changed) return;
 	
-	fprintf(cHeaderFP, "%s%s\n", HEADER_GUARD_START_TOKEN, S.headerGuard.c_str());
+	// lock the file that is current once the lock is held; a process that
+	// waited on a file renamed away meanwhile tries again
+	int lockFd;
+	for (;;)
+	{
+		lockFd = open(M.fileName.c_str(), O_RDWR | O_CREAT, 0666);
+		if (lockFd < 0 || flock(lockFd, LOCK_EX) != 0)
+		{
+			fprintf(stderr, "warning: can not lock manifest \"%s\": %s\n", M.fileName.c_str(), strerror(errno));
+			if (lockFd >= 0) close(lockFd);
+			return;
+		}
+		
+		struct stat locked, current;
+		if (fstat(lockFd, &locked) == 0 && stat(M.fileName.c_str(), &current) == 0 && locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) break;
+		close(lockFd);
+	}
 	
-	fprintf(cHeaderFP, "%s\n", S.introComment.c_str());
-	fprintf(cSourceFP, "%s\n", S.introComment.c_str());
+	struct manifest merged;
+	merged.fileName = M.fileName;
+	loadManifest(merged);
+	for (auto &entry : M.entries)
+	{
+		if (entry.second.recorded) merged.entries[entry.first] = entry.second;
+	}
 	
-	fprintf(cHeaderFP, "#ifndef __enumg_HeaderGuard_%s_INCLUDED__\n", S.headerGuard.c_str());
-	fprintf(cHeaderFP, "#define __enumg_HeaderGuard_%s_INCLUDED__\n", S.headerGuard.c_str());
+	std::string tmpName = M.fileName + "." + std::to_string(getpid()) + ".tmp";
+	FILE *fp = fopen(tmpName.c_str(), "w");
+	if (!fp)
+	{
+		fprintf(stderr, "warning: can not write manifest \"%s\": %s\n", tmpName.c_str(), strerror(errno));
+		close(lockFd);
+		return;
+	}
 	
-	fprintf(cSourceFP, "#include \"%s\"\n", cHeaderFileName.c_str());
+	fprintf(fp, "# enumg manifest\n");
+	for (auto &entry : merged.entries)
+	{
+		fprintf(fp, "input %s %s\n", entry.second.key.c_str(), entry.first.c_str());
+		for (auto &file : entry.second.inputs)
+		{
+			fprintf(fp, "file %s %s\n", file.second.c_str(), file.first.c_str());
+		}
+		for (auto &file : entry.second.outputs)
+		{
+			fprintf(fp, "output %s %s\n", file.second.c_str(), file.first.c_str());
+		}
+	}
 	
-	for (auto line : S.topExprs)
+	bool written = !ferror(fp);
+	if (fclose(fp) != 0) written = false;
+	if (!written || rename(tmpName.c_str(), M.fileName.c_str()) != 0)
 	{
-		fprintf(cHeaderFP, "%s\n", line.c_str());
+		fprintf(stderr, "warning: can not write manifest \"%s\": %s\n", M.fileName.c_str(), strerror(errno));
+		remove(tmpName.c_str());
 	}
 	
-	for (auto line : S.includeFiles)
+	close(lockFd);
+}
+
+//
+// On success "S" gets the recorded files, as if it had been generated
+//
+bool manifestUpToDate(struct manifest &M, const std::string &input, const std::string &key, struct statefields &S)
+{
+	manifestentry entry;
 	{
-		fprintf(cHeaderFP, "#include %s\n", line.c_str());
+		std::lock_guard<std::mutex> lock(M.mutex);
+		auto it = M.entries.find(input);
+		if (it == M.entries.end()) return false;
+		entry = it->second;
 	}
 	
-	if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
-	fprintf(cSourceFP, "#if defined(__cplusplus)\n");
-	fprintf(cSourceFP, "\t#include <cstring>\n");
-	fprintf(cSourceFP, "\t#include <cctype>\n");
-	fprintf(cSourceFP, "#else\n");
-	fprintf(cSourceFP, "\t#include <string.h>\n");
-	fprintf(cSourceFP, "\t#include <ctype.h>\n");
-	fprintf(cSourceFP, "#endif\n");
-	if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#endif\n");
+	if (entry.key != key || entry.inputs.size() == 0 || entry.outputs.size() == 0) return false;
 	
+	for (auto &file : entry.inputs)
+	{
+		if (file.second == "-" || fileHash(file.first) != file.second) return false;
+	}
+	for (auto &file : entry.outputs)
+	{
+		if (file.second == "-" || fileHash(file.first) != file.second) return false;
+	}
 	
+	for (auto &file : entry.inputs) S.inputFiles.push_back(file.first);
+	for (auto &file : entry.outputs) S.outputFiles.push_back(file.first);
+	return true;
+}
+
+void manifestRecord(struct manifest &M, const std::string &input, const std::string &key, const struct statefields &S)
+{
+	manifestentry entry;
+	entry.key = key;
+	entry.recorded = true;
+	for (auto &file : S.inputFiles)
+	{
+		entry.inputs.push_back(std::make_pair(file, fileHash(file)));
+	}
+	for (auto &file : S.outputFiles)
+	{
+		entry.outputs.push_back(std::make_pair(file, fileHash(file)));
+	}
 	
+	std::lock_guard<std::mutex> lock(M.mutex);
+	M.entries[input] = entry;
+	M.changed = true;
+}
+
+//
+// -MD/-MF: make-style dependencies, "outputs: inputs" per input file plus
+// an empty rule for every input so a deleted ini does not break the build.
+// include-file= headers are not inputs: enumg only emits their names.
+//
+std::string depfileEscape(const std::string &name)
+{
+	std::string out;
+	for (char ch : name)
+	{
+		if (ch == ' ' || ch == '#') out += '\\';
+		if (ch == '$') out += '$';
+		out += ch;
+	}
+	return out;
+}
+
+void writeDepfile(const std::string &fileName, const std::vector<const struct statefields *> &inputs)
+{
+	FILE *fp = fopen(fileName.c_str(), "w");
+	if (!fp)
+	{
+		fprintf(stderr, "can not write depfile \"%s\"\n", fileName.c_str());
+		exit(1);
+	}
 	
-	for (auto section : S.sections)
+	for (auto S : inputs)
 	{
-		logf("write enum %s\n", section.name().c_str());
-		fprintf(cHeaderFP, "%s %s\n{\n", section.type().c_str(), section.name().c_str());
-		
-		for (auto entry : section.entries())
+		for (unsigned i = 0; i < S->outputFiles.size(); ++i)
 		{
-			// fill out header enum decl
-			fprintf(cHeaderFP, "\t%s,\n", entry.fullText().c_str());
-		}
-		
-		if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
-		
-		//
-		// enum field name string array
-		//
-		fprintf(cSourceFP, "const char *g_%sStringArray[] = {\n", section.name().c_str());
-		for (auto entry : section.entries())
-		{	
-			fprintf(cSourceFP, "\t\"%s\",\n", entry.name().c_str());
+			fprintf(fp, "%s%s", i > 0 ? " " : "", depfileEscape(S->outputFiles[i]).c_str());
 		}
-		fprintf(cSourceFP, "};\n");
-		
-		//
-		// value array
-		//
-		fprintf(cSourceFP, "%s g_%sValueArray[] = \n{\n", section.name().c_str(), section.name().c_str());
-		for (auto entry : section.entries())
+		fprintf(fp, ":");
+		for (auto &file : S->inputFiles)
 		{
-			fprintf(cSourceFP, "\t%s,\n", entry.name().c_str());
+			fprintf(fp, " %s", depfileEscape(file).c_str());
 		}
-		fprintf(cSourceFP, "};\n");
-		
-		//
-		// to c-string
-		//
-		fprintf(cSourceFP, "const char *%sToString(%s value)\n", section.name().c_str(), section.name().c_str());
-		fprintf(cSourceFP, "{\n");
-		fprintf(cSourceFP, "\tint ix = %sToIndex(value);\n", section.name().c_str());
-		fprintf(cSourceFP, "\tif (ix >= 0) {\n");
-		fprintf(cSourceFP, "\t\treturn g_%sStringArray[ix];\n", section.name().c_str());
-		fprintf(cSourceFP, "\t} else {\n");
-		fprintf(cSourceFP, "\t\treturn nullptr;\n");
-		fprintf(cSourceFP, "\t}\n");
-		fprintf(cSourceFP, "}\n");
-		
-		
-		
-		
-		if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#endif\n");
-		
-		fprintf(cHeaderFP, "};\n");
-		
-		if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
-		fprintf(cHeaderFP, "const char *%sToString(%s value);\n", section.name().c_str(), section.name().c_str());
-		fprintf(cHeaderFP, "%s %sFromString(const char *str);\n", section.name().c_str(), section.name().c_str());
-		fprintf(cHeaderFP, "unsigned %sValueCount();\n", section.name().c_str());
-		fprintf(cHeaderFP, "%s %sFromIndex(unsigned index);\n", section.name().c_str(), section.name().c_str());
-		fprintf(cHeaderFP, "int %sFromString(const char *str, %s *presult, bool ignoreCase = false, int ignorePrefixLen = 0);\n", section.name().c_str(), section.name().c_str());
-		fprintf(cHeaderFP, "int %sToIndex(%s value);\n", section.name().c_str(), section.name().c_str());
-		if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#endif\n");
-		
-		if (section.thraitsName().size() > 0)
+		fprintf(fp, "\n");
+	}
+	
+	for (auto S : inputs)
+	{
+		for (auto &file : S->inputFiles)
 		{
-			if (section.thraitsEnableMacro().size() > 0) {
-				fprintf(cHeaderFP, "#if defined(%s)\n", section.thraitsEnableMacro().c_str());
-			}
-			
-			fprintf(cHeaderFP, "const %s *%s_GetThraits(%s value, const %s *defaultResult = nullptr);\n", section.thraitsName().c_str(), section.name().c_str(), section.name().c_str(), section.thraitsName().c_str());
-			
-			if (section.thraitsEnableMacro().size() > 0) {
-				fprintf(cHeaderFP, "#endif // %s\n", section.thraitsEnableMacro().c_str());
-			}
+			fprintf(fp, "\n%s:\n", depfileEscape(file).c_str());
 		}
-		
-//		if (!S.cppStringifyDisable)
-//		{
-//			if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#if defined(%s) && defined(__cplusplus)\n", S.stringifyDefine.c_str());
-//			fprintf(cHeaderFP, "void %sToCppString(std::string &out, %s value);\n", section.name().c_str(), section.name().c_str());
-//			if (S.stringifyDefine.size() > 0) fprintf(cHeaderFP, "#endif\n");
+	}
+	
+	fclose(fp);
+}
+
 //
+// --tune: build each candidate lookup of a section into a small timing
+// program with the system compiler and keep the fastest. Results are
+// cached by a hash of the section, enumg version and compiler.
 //
-//			if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#if defined(%s) && defined(__cplusplus)\n", S.stringifyDefine.c_str());
-//			fprintf(cSourceFP, "void %sToCppString(std::string &out, %s value)\n{\n", section.name().c_str(), section.name().c_str());
-//			fprintf(cSourceFP, "\tout = %sToString(value);\n", section.name().c_str());
-//			fprintf(cSourceFP, "}\n");
-//			if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#endif\n");
-//		}
-		
-		if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#if defined(%s)\n", S.stringifyDefine.c_str());
-		//
-		// from index
-		//
-		fprintf(cSourceFP, "%s %sFromIndex(unsigned index)\n{\n", section.name().c_str(), section.name().c_str());
-		fprintf(cSourceFP, "\treturn g_%sValueArray[index];\n", section.name().c_str());
-		fprintf(cSourceFP, "}\n");
-		fprintf(cSourceFP, "unsigned %sValueCount()\n{\n", section.name().c_str());
-		fprintf(cSourceFP, "\treturn %u;\n", (unsigned)section.entries().size());
-		fprintf(cSourceFP, "}\n");
-		
-		//
-		// from string 
-		//
-		fprintf(cSourceFP, "int %sFromString(const char *str, %s *presult, bool ignoreCase, int ignorePrefixLen)\n{\n", section.name().c_str(), section.name().c_str());
-		
-		fprintf(cSourceFP, "\tunsigned len = %sValueCount();\n", section.name().c_str());
-		fprintf(cSourceFP, "\tfor(unsigned i = 0; i < len; ++i)\n\t{\n");
-		fprintf(cSourceFP, "\t\t%s value = %sFromIndex(i);\n", section.name().c_str(), section.name().c_str());
-		fprintf(cSourceFP, "\t\tconst char *checkStr = %sToString(value);\n", section.name().c_str());
-		fprintf(cSourceFP, "\t\tbool equal = true;\n");
-		fprintf(cSourceFP, "\t\tfor (const char *a = str, *b = checkStr + ignorePrefixLen; ; ++a, ++b)\n");
-		fprintf(cSourceFP, "\t\t{\n");
-		fprintf(cSourceFP, "\t\t\tif (*a == (char)0 || *b == (char)0)\n");
-		fprintf(cSourceFP, "\t\t\t{\n");
-		fprintf(cSourceFP, "\t\t\t\tequal = (*a == *b);\n");
-		fprintf(cSourceFP, "\t\t\t\tbreak;\n");
-		fprintf(cSourceFP, "\t\t\t}\n");
-		fprintf(cSourceFP, "\t\t\tchar x, y;\n");
-		fprintf(cSourceFP, "\t\t\tif (ignoreCase) { x = tolower(*a); y = tolower(*b); }\n");
-		fprintf(cSourceFP, "\t\t\telse { x = *a; y = *b; }\n");
-		fprintf(cSourceFP, "\t\t\tif (x != y)\n");
-		fprintf(cSourceFP, "\t\t\t{\n");
-		fprintf(cSourceFP, "\t\t\t\tequal = false;\n");
-		fprintf(cSourceFP, "\t\t\t\tbreak;\n");
-		fprintf(cSourceFP, "\t\t\t}\n");
-		fprintf(cSourceFP, "\t\t}\n");
-		////////fprintf(cSourceFP, "\t\tif (0 == strcmp(str, checkStr))\n\t\t{\n");
-		fprintf(cSourceFP, "\t\tif (equal)\n\t\t{\n");
-		fprintf(cSourceFP, "\t\t\t*presult = value; return 0;\n");
-		fprintf(cSourceFP, "\t\t}\n");
-		fprintf(cSourceFP, "\t}\n");
-		fprintf(cSourceFP, "\treturn -1;\n");
-		fprintf(cSourceFP, "}\n");
-		
-		//
-		// To Index
-		//
-		fprintf(cSourceFP, "int %sToIndex(%s value)\n", section.name().c_str(), section.name().c_str());
-		fprintf(cSourceFP, "{\n");
-		fprintf(cSourceFP, "\tunsigned count = %sValueCount();\n", section.name().c_str());
-		fprintf(cSourceFP, "\tfor (unsigned i = 0; i < count; ++i) {\n");
-		fprintf(cSourceFP, "\t\tif (value == g_%sValueArray[i]) { return i; }\n", section.name().c_str());
-		fprintf(cSourceFP, "\t}\n");
-		fprintf(cSourceFP, "\treturn -1;\n");
-		fprintf(cSourceFP, "}\n");
+std::string tuneKey(const struct statefields &S, const Section &section, const std::string &compiler)
+{
+	std::string text = std::string(ENUMG_VERSION) + "\n" + compiler + "\n" + (S.sizeProfile ? "size" : "speed") + "\n";
+	text += section.name() + "\n" + section.type() + "\n";
+	for (auto &entry : section.entries())
+	{
+		text += std::string(entry.fullText()) + "\n" + std::to_string(entry.weight()) + "\n";
+	}
+	
+	return hashHex(phHash(text.data(), text.size(), 14695981039346656037ULL));
+}
+
+//
+// Time ToIndex and FromString of "section" as generated with the given
+// strategies; false if the candidate does not build or run
+//
+bool tuneMeasure(const struct statefields &S, const Section &section, const std::string &compiler, const std::string &dir, int lookup, int stringLookup, double &toIndexNs, double &fromStringNs)
+{
+	struct statefields T;
+	T.fileName = dir + "/tune.ini";
+	T.cHeader = "h";
+	T.cSource = "cpp";
+	T.sizeProfile = S.sizeProfile;
+	T.firstField = true;
+	T.cppStringifyDisable = true;
+	
+	// only what ToIndex and FromString depend on
+	Section candidate(section.name());
+	candidate.type(section.type());
+	candidate.lookup(lookup);
+	candidate.stringLookup(stringLookup);
+	candidate.entries() = section.entries();
+	T.sections.push_back(candidate);
+	
+	bool silent = g_threadSilent;
+	g_threadSilent = true;
+	makeEnumFiles(T);
+	g_threadSilent = silent;
+	
+	const char *name = section.name().c_str();
+	FILE *fp = fopen((dir + "/main.cpp").c_str(), "w");
+	if (!fp) return false;
+	fprintf(fp, "#include \"tune.h\"\n");
+	fprintf(fp, "#include <chrono>\n");
+	fprintf(fp, "#include <cstdio>\n");
+	fprintf(fp, "static %s values[4096];\n", name);
+	fprintf(fp, "static const char *names[4096];\n");
+	fprintf(fp, "int main()\n{\n");
+	fprintf(fp, "\tunsigned long long state = 88172645463325252ULL, sum = 0;\n");
+	fprintf(fp, "\tfor (unsigned i = 0; i < 4096; ++i)\n\t{\n");
+	fprintf(fp, "\t\tstate = state * 6364136223846793005ULL + 1442695040888963407ULL;\n");
+	fprintf(fp, "\t\tvalues[i] = %sFromIndex((unsigned)(state >> 33) %% %sValueCount());\n", name, name);
+	fprintf(fp, "\t\tnames[i] = %sToString(values[i]);\n", name);
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\tdouble best[2] = { 1e30, 1e30 };\n");
+	fprintf(fp, "\tfor (int rep = 0; rep < 5; ++rep)\n\t{\n");
+	fprintf(fp, "\t\tauto t0 = std::chrono::steady_clock::now();\n");
+	fprintf(fp, "\t\tfor (int r = 0; r < 100; ++r) for (unsigned i = 0; i < 4096; ++i) sum += (unsigned)%sToIndex(values[i]);\n", name);
+	fprintf(fp, "\t\tauto t1 = std::chrono::steady_clock::now();\n");
+	fprintf(fp, "\t\t%s v;\n", name);
+	fprintf(fp, "\t\tfor (int r = 0; r < 100; ++r) for (unsigned i = 0; i < 4096; ++i) { sum += (unsigned)%sFromString(names[i], &v, false, 0); sum += (unsigned long long)v; }\n", name);
+	fprintf(fp, "\t\tauto t2 = std::chrono::steady_clock::now();\n");
+	fprintf(fp, "\t\tdouble a = std::chrono::duration<double, std::nano>(t1 - t0).count() / 409600;\n");
+	fprintf(fp, "\t\tdouble b = std::chrono::duration<double, std::nano>(t2 - t1).count() / 409600;\n");
+	fprintf(fp, "\t\tif (a < best[0]) best[0] = a;\n");
+	fprintf(fp, "\t\tif (b < best[1]) best[1] = b;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\tprintf(\"%%f %%f %%llu\\n\", best[0], best[1], sum & 1);\n");
+	fprintf(fp, "\treturn 0;\n");
+	fprintf(fp, "}\n");
+	fclose(fp);
+	
+	std::string build = compiler + " -std=c++17 -O2 -o " + dir + "/tune " + dir + "/main.cpp " + dir + "/tune.cpp > /dev/null 2>&1";
+	if (system(build.c_str()) != 0) return false;
+	
+	FILE *pp = popen((dir + "/tune").c_str(), "r");
+	if (!pp) return false;
+	unsigned long long dummy;
+	int n = fscanf(pp, "%lf %lf %llu", &toIndexNs, &fromStringNs, &dummy);
+	return pclose(pp) == 0 && n == 3;
+}
+
+void tuneSections(struct statefields &S)
+{
+	const char *cxx = getenv("CXX");
+	std::string compiler = cxx && *cxx ? cxx : "c++";
+	
+	// cache: "key lookup string-lookup" per line
+	std::vector<std::string> cacheLines;
+	FILE *fp = fopen(S.tuneCache.c_str(), "r");
+	if (fp)
+	{
+		char line[256];
+		while (fgets(line, sizeof(line), fp))
+		{
+			line[strcspn(line, "\r\n")] = 0;
+			if (line[0] != 0 && line[0] != '#') cacheLines.push_back(line);
+		}
+		fclose(fp);
+	}
+	
+	bool cacheChanged = false;
+	
+	for (auto &section : S.sections)
+	{
+		if (section.lookup() != LOOKUP_AUTO && section.stringLookup() != STRLOOKUP_AUTO) continue;
 		
-		if (S.stringifyDefine.size() > 0) fprintf(cSourceFP, "#endif\n");
+		struct indexplan plan;
+		planIndexLookup(S, section, plan);
+		if (!plan.resolved)
+		{
+			logf("%s: values not known at generation time, not tuned\n", section.name().c_str());
+			continue;
+		}
 		
+		std::string key = tuneKey(S, section, compiler);
+		int lookup = -1, stringLookup = -1;
+		for (auto &line : cacheLines)
+		{
+			char lookupName[32], stringLookupName[32];
+			if (line.compare(0, key.size(), key) == 0 && sscanf(line.c_str() + key.size(), "%31s %31s", lookupName, stringLookupName) == 2)
+			{
+				lookup = parseLookupStrategy(lookupName);
+				stringLookup = strcmp(stringLookupName, "linear") == 0 ? STRLOOKUP_LINEAR : STRLOOKUP_HASH;
+			}
+		}
 		
+		// cached by an older enumg that did not bound the table
+		if (lookup == LOOKUP_TABLE && (!plan.compact || S.sizeProfile)) lookup = -1;
 		
-		//
-		// thraits
-		//
-		if (section.thraitsName().size() > 0) 
+		if (lookup < 0)
 		{
-			if (section.thraitsEnableMacro().size() > 0) {
-				fprintf(cSourceFP, "#if defined(%s)\n", section.thraitsEnableMacro().c_str());
+			char dirTemplate[] = "/tmp/enumg_tune_XXXXXX";
+			if (!mkdtemp(dirTemplate))
+			{
+				fprintf(stderr, "warning: [%s] can not create tuning directory\n", section.name().c_str());
+				continue;
 			}
+			std::string dir = dirTemplate;
 			
-			std::vector<Entry> list;
-			for (auto entry : section.entries())
+			bool contiguous = true;
+			for (unsigned i = 0; i < plan.values.size(); ++i)
 			{
-				if (entry.thraits().size() > 0)
+				if (plan.values[i] != plan.minValue + (long long)i) contiguous = false;
+			}
+			
+			std::vector<int> candidates = { LOOKUP_LINEAR, LOOKUP_BINARY, LOOKUP_SWITCH };
+			// same bound as lookup=auto: no table far larger than the enum
+			if (plan.compact && !S.sizeProfile) candidates.push_back(LOOKUP_TABLE);
+			if (contiguous) candidates.push_back(LOOKUP_OFFSET);
+			
+			double bestToIndex = 1e30, bestHash = 1e30, bestLinear = 1e30;
+			for (int candidate : candidates)
+			{
+				double toIndexNs, fromStringNs;
+				if (!tuneMeasure(S, section, compiler, dir, candidate, STRLOOKUP_HASH, toIndexNs, fromStringNs)) continue;
+				logf("%s: tune lookup=%s %.2f ns, string-lookup=hash %.2f ns\n", section.name().c_str(), g_lookupStrategyNames[candidate], toIndexNs, fromStringNs);
+				if (toIndexNs < bestToIndex)
 				{
-					list.push_back(entry);
+					bestToIndex = toIndexNs;
+					lookup = candidate;
 				}
+				bestHash = std::min(bestHash, fromStringNs);
 			}
 			
-			fprintf(cSourceFP, "\n");
-			
-			fprintf(cSourceFP, "class __%sThraitsHolder {\n", section.name().c_str());
-			fprintf(cSourceFP, "public:\n");
-			fprintf(cSourceFP, "\t%s key; %s *value;\n", section.name().c_str(), section.thraitsName().c_str());
-			fprintf(cSourceFP, "\t__%sThraitsHolder(%s keyArg, %s *valueArg) : key(keyArg), value(valueArg) { }\n", section.name().c_str(), section.name().c_str(), section.thraitsName().c_str());
-			fprintf(cSourceFP, "\t~__%sThraitsHolder() { if (value != nullptr) delete value; }\n", section.name().c_str());
-			fprintf(cSourceFP, "};\n");
+			double toIndexNs;
+			if (lookup >= 0 && tuneMeasure(S, section, compiler, dir, lookup, STRLOOKUP_LINEAR, toIndexNs, bestLinear))
+			{
+				logf("%s: tune string-lookup=linear %.2f ns\n", section.name().c_str(), bestLinear);
+			}
+			stringLookup = bestLinear < bestHash ? STRLOOKUP_LINEAR : STRLOOKUP_HASH;
 			
-			//fprintf(cSourceFP, "%s g_%sThraitsArray[%d] = {\n", section.thraitsName().c_str(), section.name().c_str(), (int)list.size());
-			fprintf(cSourceFP, "__%sThraitsHolder g_%sThraitsArray[%d] = {\n", 
-				section.name().c_str(), section.name().c_str(), (int)list.size()
-			);
+			std::filesystem::remove_all(dir);
 			
-			for (unsigned i = 0; i < list.size(); ++i)
+			if (lookup < 0)
 			{
-				std::string nameKey = list[i].name().c_str();
-				std::string data = "new " + section.thraitsName() + list[i].thraits().c_str();
-				fprintf(cSourceFP, "\t__%sThraitsHolder(%s, %s)", section.name().c_str(), nameKey.c_str(), data.c_str());
-				
-				if (i < list.size() -1) fprintf(cSourceFP, ",");
-				fprintf(cSourceFP, "\n");
-			} 
-			fprintf(cSourceFP, "};\n");
-			fprintf(cSourceFP, "const %s *%s_GetThraits(%s value, const %s *defaultResult)\n{\n", section.thraitsName().c_str(), section.name().c_str(), section.name().c_str(), section.thraitsName().c_str());
-			fprintf(cSourceFP, "\tfor (int i = 0; i < %d; ++i) {\n", (int)list.size());
-			fprintf(cSourceFP, "\t\tauto &item = g_%sThraitsArray[i];\n", section.name().c_str());
-			fprintf(cSourceFP, "\t\tif (item.key == value) return item.value;\n");
-			fprintf(cSourceFP, "\t}\n");
-			fprintf(cSourceFP, "\treturn defaultResult;\n");
-			fprintf(cSourceFP, "}\n");
-			
-			if (section.thraitsEnableMacro().size() > 0) {
-				fprintf(cSourceFP, "#endif // %s\n", section.thraitsEnableMacro().c_str());
+				fprintf(stderr, "warning: [%s] tuning failed (%s), keeping lookup=auto\n", section.name().c_str(), compiler.c_str());
+				continue;
 			}
+			
+			cacheLines.push_back(key + " " + g_lookupStrategyNames[lookup] + " " + (stringLookup == STRLOOKUP_LINEAR ? "linear" : "hash"));
+			cacheChanged = true;
 		}
 		
-		
+		logf("%s: tuned lookup=%s string-lookup=%s\n", section.name().c_str(), g_lookupStrategyNames[lookup], stringLookup == STRLOOKUP_LINEAR ? "linear" : "hash");
+		if (section.lookup() == LOOKUP_AUTO) section.lookup(lookup);
+		if (section.stringLookup() == STRLOOKUP_AUTO) section.stringLookup(stringLookup);
 	}
 	
-	for (auto line : S.bottomExprs)
+	if (cacheChanged)
 	{
-		fprintf(cHeaderFP, "%s\n", line.c_str());
-	}
-	
-	fprintf(cHeaderFP, "#endif // (header guard)\n");
-	fclose(cHeaderFP);
-	fclose(cSourceFP);
-	
-	auto copyOptions = std::filesystem::copy_options::overwrite_existing;
-	
-	if (file_compare(cHeaderActualFileName, final_cHeaderActualFileName) != 0) {
-		std::filesystem::copy(cHeaderActualFileName, final_cHeaderActualFileName, copyOptions);
-	}
-	
-	if (file_compare(cSourceFileName, final_cSourceFileName) != 0) {
-		std::filesystem::copy(cSourceFileName, final_cSourceFileName, copyOptions);
+		fp = fopen(S.tuneCache.c_str(), "w");
+		if (!fp)
+		{
+			fprintf(stderr, "warning: can not write tuning cache \"%s\"\n", S.tuneCache.c_str());
+			return;
+		}
+		fprintf(fp, "# enumg --tune cache: key lookup string-lookup\n");
+		for (auto &line : cacheLines)
+		{
+			fprintf(fp, "%s\n", line.c_str());
+		}
+		fclose(fp);
 	}
-	
-	remove(cHeaderActualFileName.c_str());
-	remove(cSourceFileName.c_str());
 }
 
 int main(int argc, char **argv)
@@ -861,6 +4160,33 @@ int main(int argc, char **argv)
 
 	for (int i = 1; i < argc; ++i)
 	{
+		if (isParam(argv[i], "-j"))
+		{
+			// "-j N" or "-jN"
+			const char *count = argv[i][2] != 0 ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+			char *end = nullptr;
+			unsigned long jobs = strtoul(count, &end, 10);
+			if (end == count || *end != 0 || jobs == 0)
+			{
+				fprintf(stderr, "-j expects a positive number of jobs\n");
+				exit(1);
+			}
+			opts.jobs = jobs;
+			continue;
+		}
+		else if (isParam(argv[i], "-MF"))
+		{
+			// "-MF FILE" or "-MFFILE"
+			opts.depfile = true;
+			opts.depfileName = argv[i][3] != 0 ? argv[i] + 3 : (i + 1 < argc ? argv[++i] : "");
+			if (opts.depfileName.empty())
+			{
+				fprintf(stderr, "-MF expects a file name\n");
+				exit(1);
+			}
+			continue;
+		}
+		
 		checkParam(inputFiles, opts, argv[i]);
 	}
 	
@@ -889,23 +4215,119 @@ int main(int argc, char **argv)
 		
 		for (int i = 0; i < argc; ++i)
 		{
+			// options that do not change the output
+			if (isParam(argv[i], "-j") || isParam(argv[i], "-MF"))
+			{
+				if (argv[i][isParam(argv[i], "-j") ? 2 : 3] == 0) ++i;
+				continue;
+			}
+			if (isParam(argv[i], "-V") || isParam(argv[i], "-MD") || isParam(argv[i], "--manifest=")) continue;
 			introComment += std::string(argv[i]) + std::string(" ");
 		}
 		
 		introComment += "\n";
 		
-		for (auto file : inputFiles)
-		{
-			struct statefields S;
-			S.introComment = introComment;
-			S.fileName = file;
-			logf("================================\n");
-			logf("input: %s\n", file.c_str());
-			logf("--------------parse-------------\n");
-			process(S, opts, file.c_str());
-			logf("------------write file----------\n");
-			makeEnumFiles(S);
-			logf("================================\n");
+		//
+		// input files are independent; workers take the next one until all
+		// are done. Each file's log is printed in one piece when it is done.
+		//
+		std::atomic<unsigned> nextFile(0);
+		std::mutex tuneMutex;
+		
+		struct manifest M;
+		M.fileName = opts.manifest;
+		std::string manifestKeyText = manifestKey(opts, introComment);
+		if (M.fileName.size() > 0)
+		{
+			loadManifest(M);
+		}
+		
+		std::vector<struct statefields> done(inputFiles.size());
+		
+		auto worker = [&]()
+		{
+			std::string log;
+			g_threadLog = &log;
+			
+			for (unsigned ix = nextFile++; ix < inputFiles.size(); ix = nextFile++)
+			{
+				const std::string &file = inputFiles[ix];
+				struct statefields &S = done[ix];
+				if (M.fileName.size() > 0 && manifestUpToDate(M, file, manifestKeyText, S))
+				{
+					logf("input: %s unchanged\n", file.c_str());
+				}
+				else
+				{
+					S.introComment = introComment;
+					S.fileName = file;
+					S.emitBench = opts.emitBench;
+					logf("================================\n");
+					logf("input: %s\n", file.c_str());
+					logf("--------------parse-------------\n");
+					process(S, opts, file.c_str());
+					if (opts.tune)
+					{
+						// one at a time: timings and the shared cache file
+						std::lock_guard<std::mutex> lock(tuneMutex);
+						logf("--------------tune--------------\n");
+						tuneSections(S);
+					}
+					logf("------------write file----------\n");
+					makeEnumFiles(S);
+					logf("================================\n");
+					
+					if (M.fileName.size() > 0)
+					{
+						manifestRecord(M, file, manifestKeyText, S);
+					}
+				}
+				
+				if (opts.depfile && opts.depfileName.empty())
+				{
+					// next to the source: "<src-dir><title>.d"
+					std::filesystem::path depfileName = S.outputFiles[1];
+					writeDepfile(depfileName.replace_extension(".d").string(), { &S });
+				}
+				
+				// only the file lists are needed from here on
+				S.sections.clear();
+				S.sections.shrink_to_fit();
+				
+				std::lock_guard<std::mutex> lock(g_logMutex);
+				fwrite(log.data(), 1, log.size(), stdout);
+				fflush(stdout);
+				log.clear();
+			}
+			
+			g_threadLog = nullptr;
+		};
+		
+		unsigned jobs = std::min<size_t>(opts.jobs, inputFiles.size());
+		std::vector<std::thread> workers;
+		for (unsigned i = 1; i < jobs; ++i)
+		{
+			workers.emplace_back(worker);
+		}
+		worker();
+		for (auto &thread : workers)
+		{
+			thread.join();
+		}
+		
+		if (M.fileName.size() > 0)
+		{
+			saveManifest(M);
+		}
+		
+		if (opts.depfile && opts.depfileName.size() > 0)
+		{
+			std::vector<const struct statefields *> all;
+			for (auto &S : done)
+			{
+				all.push_back(&S);
+			}
+			writeDepfile(opts.depfileName, all);
 		}
 		
 		